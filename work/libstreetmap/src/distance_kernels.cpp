@@ -0,0 +1,232 @@
+//
+// Batch distance kernels over point arrays (AVX / SSE2 with a scalar fallback)
+//
+// Same equirectangular distance as findDistanceBetweenTwoPoints. The cosine of the average
+// latitude of two points is expanded as
+//     cos(a/2 + b/2) = cos(a/2)cos(b/2) - sin(a/2)sin(b/2)
+// with the half-latitude sin/cos stored per point, so the kernels only multiply and add.
+//
+
+#include "global.h"
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// Initialize value here
+PointArray intersection_points;
+PointArray poi_points;
+
+void build_point_array(const std::vector<LatLon>& points, PointArray& array) {
+    array.lat.resize(points.size());
+    array.lon.resize(points.size());
+    array.cos_half_lat.resize(points.size());
+    array.sin_half_lat.resize(points.size());
+
+    for (int i = 0; i < points.size(); ++i) {
+        double lat = points[i].latitude() * kDegreeToRadian;
+        array.lat[i] = lat;
+        array.lon[i] = points[i].longitude() * kDegreeToRadian;
+        array.cos_half_lat[i] = cos(lat / 2.0);
+        array.sin_half_lat[i] = sin(lat / 2.0);
+    }
+}
+
+// distance in meters between points a and b of the array
+double point_distance(const PointArray& points, int a, int b) {
+    double cos_avg = points.cos_half_lat[a] * points.cos_half_lat[b] - points.sin_half_lat[a] * points.sin_half_lat[b];
+    double dx = (points.lon[b] - points.lon[a]) * cos_avg;
+    double dy = points.lat[b] - points.lat[a];
+    return kEarthRadiusInMeters * sqrt(dx * dx + dy * dy);
+}
+
+// distances in meters from one position to points first .. first + count - 1 of the array,
+// out[i] is the distance to point first + i
+void distances_from_point(LatLon from, const PointArray& points, int first, int count, double* out) {
+    double lat = from.latitude() * kDegreeToRadian;
+    double lon = from.longitude() * kDegreeToRadian;
+    double cos_half = cos(lat / 2.0);
+    double sin_half = sin(lat / 2.0);
+    const double* p_lat = points.lat.data() + first;
+    const double* p_lon = points.lon.data() + first;
+    const double* p_cos = points.cos_half_lat.data() + first;
+    const double* p_sin = points.sin_half_lat.data() + first;
+    int i = 0;
+
+#if defined(__AVX__)
+    __m256d v_lat = _mm256_set1_pd(lat), v_lon = _mm256_set1_pd(lon);
+    __m256d v_cos = _mm256_set1_pd(cos_half), v_sin = _mm256_set1_pd(sin_half);
+    __m256d v_radius = _mm256_set1_pd(kEarthRadiusInMeters);
+    for (; i + 4 <= count; i += 4) {
+        __m256d cos_avg = _mm256_sub_pd(_mm256_mul_pd(v_cos, _mm256_loadu_pd(p_cos + i)),
+                                        _mm256_mul_pd(v_sin, _mm256_loadu_pd(p_sin + i)));
+        __m256d dx = _mm256_mul_pd(_mm256_sub_pd(_mm256_loadu_pd(p_lon + i), v_lon), cos_avg);
+        __m256d dy = _mm256_sub_pd(_mm256_loadu_pd(p_lat + i), v_lat);
+        __m256d squared = _mm256_add_pd(_mm256_mul_pd(dx, dx), _mm256_mul_pd(dy, dy));
+        _mm256_storeu_pd(out + i, _mm256_mul_pd(v_radius, _mm256_sqrt_pd(squared)));
+    }
+#elif defined(__SSE2__)
+    __m128d v_lat = _mm_set1_pd(lat), v_lon = _mm_set1_pd(lon);
+    __m128d v_cos = _mm_set1_pd(cos_half), v_sin = _mm_set1_pd(sin_half);
+    __m128d v_radius = _mm_set1_pd(kEarthRadiusInMeters);
+    for (; i + 2 <= count; i += 2) {
+        __m128d cos_avg = _mm_sub_pd(_mm_mul_pd(v_cos, _mm_loadu_pd(p_cos + i)),
+                                     _mm_mul_pd(v_sin, _mm_loadu_pd(p_sin + i)));
+        __m128d dx = _mm_mul_pd(_mm_sub_pd(_mm_loadu_pd(p_lon + i), v_lon), cos_avg);
+        __m128d dy = _mm_sub_pd(_mm_loadu_pd(p_lat + i), v_lat);
+        __m128d squared = _mm_add_pd(_mm_mul_pd(dx, dx), _mm_mul_pd(dy, dy));
+        _mm_storeu_pd(out + i, _mm_mul_pd(v_radius, _mm_sqrt_pd(squared)));
+    }
+#endif
+
+    // the tail (or everything without SIMD)
+    for (; i < count; ++i) {
+        double cos_avg = cos_half * p_cos[i] - sin_half * p_sin[i];
+        double dx = (p_lon[i] - lon) * cos_avg;
+        double dy = p_lat[i] - lat;
+        out[i] = kEarthRadiusInMeters * sqrt(dx * dx + dy * dy);
+    }
+}
+
+// index of the point of the array closest to the position, -1 if the array is empty
+int closest_point(LatLon from, const PointArray& points) {
+    // distances are computed in blocks so the buffer stays in cache
+    const int block = 1024;
+    double distances[block];
+
+    int closest = -1;
+    double closest_distance = std::numeric_limits<double>::infinity();
+    for (int first = 0; first < points.lat.size(); first += block) {
+        int count = std::min<int>(block, points.lat.size() - first);
+        distances_from_point(from, points, first, count, distances);
+
+        for (int i = 0; i < count; ++i) {
+            if (distances[i] < closest_distance) {
+                closest_distance = distances[i];
+                closest = first + i;
+            }
+        }
+    }
+    return closest;
+}
+
+// total length in meters of the polyline through the points of the array, in order
+double polyline_length(const PointArray& points) {
+    int count = points.lat.size();
+    double length = 0.0;
+    int i = 0;
+
+#if defined(__AVX__)
+    __m256d v_radius = _mm256_set1_pd(kEarthRadiusInMeters);
+    __m256d sum = _mm256_setzero_pd();
+    for (; i + 5 <= count; i += 4) {
+        __m256d cos_avg = _mm256_sub_pd(
+            _mm256_mul_pd(_mm256_loadu_pd(&points.cos_half_lat[i]), _mm256_loadu_pd(&points.cos_half_lat[i + 1])),
+            _mm256_mul_pd(_mm256_loadu_pd(&points.sin_half_lat[i]), _mm256_loadu_pd(&points.sin_half_lat[i + 1])));
+        __m256d dx = _mm256_mul_pd(_mm256_sub_pd(_mm256_loadu_pd(&points.lon[i + 1]), _mm256_loadu_pd(&points.lon[i])),
+                                   cos_avg);
+        __m256d dy = _mm256_sub_pd(_mm256_loadu_pd(&points.lat[i + 1]), _mm256_loadu_pd(&points.lat[i]));
+        __m256d squared = _mm256_add_pd(_mm256_mul_pd(dx, dx), _mm256_mul_pd(dy, dy));
+        sum = _mm256_add_pd(sum, _mm256_mul_pd(v_radius, _mm256_sqrt_pd(squared)));
+    }
+    double lanes[4];
+    _mm256_storeu_pd(lanes, sum);
+    length = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+#elif defined(__SSE2__)
+    __m128d v_radius = _mm_set1_pd(kEarthRadiusInMeters);
+    __m128d sum = _mm_setzero_pd();
+    for (; i + 3 <= count; i += 2) {
+        __m128d cos_avg = _mm_sub_pd(
+            _mm_mul_pd(_mm_loadu_pd(&points.cos_half_lat[i]), _mm_loadu_pd(&points.cos_half_lat[i + 1])),
+            _mm_mul_pd(_mm_loadu_pd(&points.sin_half_lat[i]), _mm_loadu_pd(&points.sin_half_lat[i + 1])));
+        __m128d dx = _mm_mul_pd(_mm_sub_pd(_mm_loadu_pd(&points.lon[i + 1]), _mm_loadu_pd(&points.lon[i])), cos_avg);
+        __m128d dy = _mm_sub_pd(_mm_loadu_pd(&points.lat[i + 1]), _mm_loadu_pd(&points.lat[i]));
+        __m128d squared = _mm_add_pd(_mm_mul_pd(dx, dx), _mm_mul_pd(dy, dy));
+        sum = _mm_add_pd(sum, _mm_mul_pd(v_radius, _mm_sqrt_pd(squared)));
+    }
+    double lanes[2];
+    _mm_storeu_pd(lanes, sum);
+    length = lanes[0] + lanes[1];
+#endif
+
+    for (; i + 1 < count; ++i) {
+        length += point_distance(points, i, i + 1);
+    }
+    return length;
+}
+
+// build the arrays used by findClosestIntersection, findClosestPOI and the A* heuristic
+void load_point_arrays() {
+    std::vector<LatLon> positions(getNumIntersections());
+    for (int i = 0; i < positions.size(); ++i) {
+        positions[i] = getIntersectionPosition(i);
+    }
+    build_point_array(positions, intersection_points);
+
+    positions.resize(getNumPointsOfInterest());
+    for (int i = 0; i < positions.size(); ++i) {
+        positions[i] = getPOIPosition(i);
+    }
+    build_point_array(positions, poi_points);
+}
+
+void clear_point_arrays() {
+    intersection_points = PointArray();
+    poi_points = PointArray();
+}
+
+// microbenchmark of the kernels against findDistanceBetweenTwoPoints on the loaded map,
+// prints the points per second of each
+void benchmark_distance_kernels(int repeats) {
+    int count = intersection_points.lat.size();
+    if (count == 0) {
+        std::cout << "benchmark_distance_kernels: no map loaded" << std::endl;
+        return;
+    }
+
+    std::vector<double> distances(count);
+    double checksum = 0.0;
+    double max_error = 0.0;
+
+    auto start = std::chrono::high_resolution_clock::now();
+    for (int r = 0; r < repeats; ++r) {
+        LatLon from = getIntersectionPosition(r % count);
+        for (int i = 0; i < count; ++i) {
+            distances[i] = findDistanceBetweenTwoPoints(from, getIntersectionPosition(i));
+        }
+        checksum += distances[r % count];
+    }
+    auto scalar_time = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+    std::vector<double> expected = distances;
+
+    start = std::chrono::high_resolution_clock::now();
+    for (int r = 0; r < repeats; ++r) {
+        distances_from_point(getIntersectionPosition(r % count), intersection_points, 0, count, distances.data());
+        checksum += distances[r % count];
+    }
+    auto batch_time = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+
+    for (int i = 0; i < count; ++i) {
+        max_error = std::max(max_error, std::abs(distances[i] - expected[i]));
+    }
+
+    start = std::chrono::high_resolution_clock::now();
+    for (int r = 0; r < repeats; ++r) {
+        checksum += polyline_length(intersection_points);
+    }
+    auto polyline_time = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+
+#if defined(__AVX__)
+    std::cout << "distance kernels (AVX), " << count << " points x " << repeats << std::endl;
+#elif defined(__SSE2__)
+    std::cout << "distance kernels (SSE2), " << count << " points x " << repeats << std::endl;
+#else
+    std::cout << "distance kernels (scalar), " << count << " points x " << repeats << std::endl;
+#endif
+    std::cout << "  findDistanceBetweenTwoPoints: " << count * repeats / scalar_time << " points/s" << std::endl;
+    std::cout << "  distances_from_point:         " << count * repeats / batch_time << " points/s" << std::endl;
+    std::cout << "  polyline_length:              " << count * repeats / polyline_time << " points/s" << std::endl;
+    std::cout << "  max difference " << max_error << " m (checksum " << checksum << ")" << std::endl;
+}
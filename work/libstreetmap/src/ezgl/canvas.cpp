@@ -22,9 +22,12 @@
 
 #include <gtk/gtk.h>
 
+#include <algorithm>
 #include <cassert>
 #include <cmath>
 #include <functional>
+#include <thread>
+#include <vector>
 
 namespace ezgl {
 
@@ -184,6 +187,134 @@ bool canvas::print_png(const char *file_name, int output_width, int output_heigh
   return true;
 }
 
+cairo_surface_t *canvas::render_to_image(rectangle world, int width, int height, draw_canvas_fn draw_callback,
+    renderer::draw_call_counts *counts) const
+{
+  cairo_surface_t *image_surface = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, width, height);
+
+  if(cairo_surface_status(image_surface) != CAIRO_STATUS_SUCCESS) {
+    cairo_surface_destroy(image_surface);
+    return nullptr; // failed to create due to errors such as out of memory
+  }
+  cairo_t *context = create_context(image_surface);
+
+  // draw on the newly created image surface & context
+  cairo_set_source_rgb(context, m_background_color.red / 255.0, m_background_color.green / 255.0,
+      m_background_color.blue / 255.0);
+  cairo_paint(context);
+
+  using namespace std::placeholders;
+  camera image_cam(world);
+  image_cam.update_widget(width, height);
+  renderer g(context, std::bind(&camera::world_to_screen, image_cam, _1), &image_cam, image_surface);
+  draw_callback(&g);
+
+  if(counts != nullptr)
+    *counts = g.get_draw_call_counts();
+
+  // free the context, the surface is returned to the caller
+  cairo_destroy(context);
+
+  return image_surface;
+}
+
+void canvas::render_parallel(renderer *g, draw_canvas_fn draw_callback, int num_strips,
+    const parallel_runner_fn &run_jobs) const
+{
+  // the camera of the renderer, which is not the canvas camera when printing
+  rectangle world = g->m_camera->get_world();
+  rectangle screen = g->m_camera->get_screen();
+  int width = static_cast<int>(std::lround(screen.width()));
+  int height = static_cast<int>(std::lround(screen.height()));
+  num_strips = std::max(1, std::min(num_strips, height));
+
+  std::vector<cairo_surface_t *> strips(num_strips, nullptr);
+  std::vector<renderer::draw_call_counts> strip_counts(num_strips);
+  std::vector<std::function<void()>> jobs;
+
+  // strip i covers the screen rows [height * i / num_strips, height * (i + 1) / num_strips), top first
+  for(int i = 0; i < num_strips; ++i) {
+    int first_row = height * i / num_strips;
+    int last_row = height * (i + 1) / num_strips;
+    double top = world.top() - world.height() * first_row / height;
+    double bottom = world.top() - world.height() * last_row / height;
+    rectangle strip_world({world.left(), bottom}, {world.right(), top});
+
+    jobs.emplace_back([=, &strips, &strip_counts]() {
+      strips[i] = render_to_image(strip_world, width, last_row - first_row, draw_callback, &strip_counts[i]);
+    });
+  }
+
+  if(run_jobs) {
+    run_jobs(jobs);
+  }
+  else {
+    std::vector<std::thread> threads;
+    for(const std::function<void()> &job : jobs)
+      threads.emplace_back(job);
+    for(std::thread &thread : threads)
+      thread.join();
+  }
+
+  // cairo contexts are not shared between threads, the strips are painted from this one
+  for(int i = 0; i < num_strips; ++i) {
+    if(strips[i] == nullptr)
+      continue;
+
+    cairo_save(g->m_cairo);
+    cairo_set_source_surface(g->m_cairo, strips[i], std::round(screen.left()),
+        std::round(screen.bottom()) + height * i / num_strips);
+    cairo_paint(g->m_cairo);
+    cairo_restore(g->m_cairo);
+    cairo_surface_destroy(strips[i]);
+    g->add_draw_call_counts(strip_counts[i]);
+  }
+}
+
+bool canvas::render_to_file(const char *file_name, rectangle world, int width, int height,
+    draw_canvas_fn draw_callback, color background_color, renderer::draw_call_counts *counts)
+{
+  std::string name(file_name);
+  bool svg = name.size() >= 4 && name.compare(name.size() - 4, 4, ".svg") == 0;
+
+  cairo_surface_t *file_surface;
+  if(svg)
+    file_surface = cairo_svg_surface_create(file_name, width, height);
+  else
+    file_surface = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, width, height);
+
+  if(cairo_surface_status(file_surface) != CAIRO_STATUS_SUCCESS) {
+    cairo_surface_destroy(file_surface);
+    return false; // failed to create due to errors such as out of memory or a bad path
+  }
+  cairo_t *context = create_context(file_surface);
+
+  // draw on the newly created surface & context
+  cairo_set_source_rgb(context, background_color.red / 255.0, background_color.green / 255.0,
+      background_color.blue / 255.0);
+  cairo_paint(context);
+
+  using namespace std::placeholders;
+  camera file_cam(world);
+  file_cam.update_widget(width, height);
+  renderer g(context, std::bind(&camera::world_to_screen, file_cam, _1), &file_cam, file_surface);
+  draw_callback(&g);
+
+  if(counts != nullptr)
+    *counts = g.get_draw_call_counts();
+
+  // an SVG file is written as it is drawn and finished when the surface is destroyed
+  bool written = true;
+  if(!svg)
+    written = cairo_surface_write_to_png(file_surface, file_name) == CAIRO_STATUS_SUCCESS;
+
+  // free surface & context
+  cairo_destroy(context);
+  cairo_surface_destroy(file_surface);
+
+  return written;
+}
+
 gboolean canvas::configure_event(GtkWidget *widget, GdkEventConfigure *, gpointer data)
 {
   // User data should have been set during the signal connection.
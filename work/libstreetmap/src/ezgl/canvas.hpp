@@ -29,7 +29,9 @@
 #include <cairo-svg.h>
 #include <gtk/gtk.h>
 
+#include <functional>
 #include <string>
+#include <vector>
 
 namespace ezgl {
 
@@ -42,6 +44,12 @@ class renderer;
  */
 using draw_canvas_fn = void (*)(renderer*);
 
+/**
+ * The signature of a function that runs every job of a list, possibly on several threads, and returns once they are
+ * all done.
+ */
+using parallel_runner_fn = std::function<void(const std::vector<std::function<void()>> &jobs)>;
+
 /**
  * Responsible for creating, destroying, and maintaining the rendering context of a GtkWidget.
  *
@@ -115,6 +123,58 @@ public:
   bool print_pdf(const char *file_name, int width = 0, int height = 0);
   bool print_svg(const char *file_name, int width = 0, int height = 0);
   bool print_png(const char *file_name, int width = 0, int height = 0);
+
+  /**
+   * Render a rectangle of the world into a new image surface with the given draw callback.
+   *
+   * The image uses a camera of its own and does not touch the canvas camera or surface, so it can be called from
+   * another thread while the canvas is being drawn (as long as the draw callback itself is thread safe).
+   *
+   * @param world          the rectangle of the world to render, with the aspect ratio of the image
+   * @param width          width of the image in pixels
+   * @param height         height of the image in pixels
+   * @param draw_callback  the function that draws the world
+   * @param counts         if not nullptr, set to the draw call counts of the renderer used
+   * @return               the new surface, to free with renderer::free_surface(), or nullptr if it could not be
+   *                       created
+   */
+  cairo_surface_t *render_to_image(rectangle world, int width, int height, draw_canvas_fn draw_callback,
+      renderer::draw_call_counts *counts = nullptr) const;
+
+  /**
+   * Render the visible world in parallel and paint it with the given renderer of this canvas.
+   *
+   * The visible world is split in horizontal strips, each strip is drawn as a job of its own with its own renderer
+   * and camera into its own image surface (see render_to_image), then the strips are painted in place. The draw
+   * call counts of the strips are added to the renderer's.
+   *
+   * @param g              the renderer of the current redraw or print of this canvas
+   * @param draw_callback  the function that draws the world, called on several threads at the same time
+   * @param num_strips     the number of strips
+   * @param run_jobs       runs the strip jobs, for example on a pool of threads the application keeps; if empty,
+   *                       each strip is drawn on a new thread
+   */
+  void render_parallel(renderer *g, draw_canvas_fn draw_callback, int num_strips,
+      const parallel_runner_fn &run_jobs = parallel_runner_fn()) const;
+
+  /**
+   * Render a rectangle of the world into a PNG or SVG file, without a canvas, window or GTK main loop.
+   *
+   * The surfaces are set up like print_png and print_svg, with a camera of their own like render_to_image, so
+   * several files can be rendered on different threads at the same time (as long as the draw callback itself is
+   * thread safe).
+   *
+   * @param file_name         name of the output file, an SVG file if it ends in ".svg" and a PNG file otherwise
+   * @param world             the rectangle of the world to render, with the aspect ratio of the image
+   * @param width             width of the image in pixels
+   * @param height            height of the image in pixels
+   * @param draw_callback     the function that draws the world
+   * @param background_color  the colour the image is cleared to before drawing
+   * @param counts            if not nullptr, set to the draw call counts of the renderer used
+   * @return                  true if the file was written
+   */
+  static bool render_to_file(const char *file_name, rectangle world, int width, int height,
+      draw_canvas_fn draw_callback, color background_color = WHITE, renderer::draw_call_counts *counts = nullptr);
   
   
 protected:
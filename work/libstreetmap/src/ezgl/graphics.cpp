@@ -151,12 +151,48 @@ rectangle renderer::world_to_screen(const rectangle& box)
   return rectangle(origin, top_right);
 }
 
+renderer::draw_call_counts renderer::get_draw_call_counts() const
+{
+  return m_draw_call_counts;
+}
+
+void renderer::reset_draw_call_counts()
+{
+  m_draw_call_counts = draw_call_counts();
+}
+
+void renderer::add_draw_call_counts(const draw_call_counts &counts)
+{
+  m_draw_call_counts.lines_drawn += counts.lines_drawn;
+  m_draw_call_counts.lines_culled += counts.lines_culled;
+  m_draw_call_counts.polys_drawn += counts.polys_drawn;
+  m_draw_call_counts.polys_culled += counts.polys_culled;
+  m_draw_call_counts.texts_drawn += counts.texts_drawn;
+  m_draw_call_counts.texts_culled += counts.texts_culled;
+  m_draw_call_counts.strokes += counts.strokes;
+}
+
+void renderer::set_cull_margin(double margin)
+{
+  m_cull_margin = margin;
+}
+
+rectangle renderer::get_cull_world()
+{
+  rectangle visible = get_visible_world();
+  if(m_cull_margin == 0.0)
+    return visible;
+
+  return rectangle({visible.left() - m_cull_margin, visible.bottom() - m_cull_margin},
+      {visible.right() + m_cull_margin, visible.top() + m_cull_margin});
+}
+
 bool renderer::rectangle_off_screen(rectangle rect)
 {
   if(current_coordinate_system == SCREEN)
     return false;
 
-  rectangle visible = get_visible_world();
+  rectangle visible = get_cull_world();
 
   if(rect.right() < visible.left())
     return true;
@@ -318,8 +354,11 @@ void renderer::set_vert_justification(justification vert_just)
 
 void renderer::draw_line(point2d start, point2d end)
 {
-  if(rectangle_off_screen({start, end}))
+  if(rectangle_off_screen({start, end})) {
+    m_draw_call_counts.lines_culled++;
     return;
+  }
+  m_draw_call_counts.lines_drawn++;
 
   if(current_coordinate_system == WORLD) {
     start = m_transform(start);
@@ -336,6 +375,134 @@ void renderer::draw_line(point2d start, point2d end)
   cairo_move_to(m_cairo, start.x, start.y);
   cairo_line_to(m_cairo, end.x, end.y);
 
+  cairo_stroke(m_cairo);
+  m_draw_call_counts.strokes++;
+}
+
+renderer::axis_transform renderer::batch_transform()
+{
+  axis_transform transform;
+  if(current_coordinate_system == SCREEN)
+    return transform;
+
+  // two corners of the visible world give the scale and the offset of each axis
+  rectangle visible = get_visible_world();
+  point2d first = m_transform(visible.bottom_left());
+  point2d second = m_transform(visible.top_right());
+  if(visible.width() > 0) {
+    transform.sx = (second.x - first.x) / visible.width();
+    transform.tx = first.x - transform.sx * visible.left();
+  }
+  if(visible.height() > 0) {
+    transform.sy = (second.y - first.y) / visible.height();
+    transform.ty = first.y - transform.sy * visible.bottom();
+  }
+  return transform;
+}
+
+void renderer::draw_polyline(point2d const *points, std::size_t count)
+{
+  if(count < 2)
+    return;
+
+  double x_min = points[0].x;
+  double x_max = points[0].x;
+  double y_min = points[0].y;
+  double y_max = points[0].y;
+
+  for(std::size_t i = 1; i < count; ++i) {
+    x_min = std::min(x_min, points[i].x);
+    x_max = std::max(x_max, points[i].x);
+    y_min = std::min(y_min, points[i].y);
+    y_max = std::max(y_max, points[i].y);
+  }
+
+  if(rectangle_off_screen({{x_min, y_min}, {x_max, y_max}})) {
+    m_draw_call_counts.lines_culled += count - 1;
+    return;
+  }
+  m_draw_call_counts.lines_drawn += count - 1;
+  m_draw_call_counts.strokes++;
+
+  axis_transform transform = batch_transform();
+
+#ifdef EZGL_USE_X11
+  if(!transparency_flag && x11_display != nullptr) {
+    std::vector<XPoint> trans_points(count);
+    for(std::size_t i = 0; i < count; ++i) {
+      point2d next_point = transform(points[i]);
+      trans_points[i].x = static_cast<long>(next_point.x);
+      trans_points[i].y = static_cast<long>(next_point.y);
+    }
+    XDrawLines(x11_display, x11_drawable, x11_context, trans_points.data(), count, CoordModeOrigin);
+    return;
+  }
+#endif
+
+  point2d next_point = transform(points[0]);
+  cairo_move_to(m_cairo, next_point.x, next_point.y);
+  for(std::size_t i = 1; i < count; ++i) {
+    next_point = transform(points[i]);
+    cairo_line_to(m_cairo, next_point.x, next_point.y);
+  }
+
+  cairo_stroke(m_cairo);
+}
+
+void renderer::draw_polyline(std::vector<point2d> const &points)
+{
+  draw_polyline(points.data(), points.size());
+}
+
+void renderer::draw_lines(point2d const *points, std::size_t count)
+{
+  // the pre-clipping of draw_line, with the visible world looked up once
+  rectangle visible = get_cull_world();
+  bool clip = current_coordinate_system == WORLD;
+  axis_transform transform = batch_transform();
+
+#ifdef EZGL_USE_X11
+  std::vector<XSegment> segments;
+#endif
+  std::size_t drawn = 0;
+
+  for(std::size_t i = 0; i + 1 < count; i += 2) {
+    point2d start = points[i];
+    point2d end = points[i + 1];
+    if(clip && (std::max(start.x, end.x) < visible.left() || std::min(start.x, end.x) > visible.right() ||
+                std::max(start.y, end.y) < visible.bottom() || std::min(start.y, end.y) > visible.top())) {
+      m_draw_call_counts.lines_culled++;
+      continue;
+    }
+    drawn++;
+
+    start = transform(start);
+    end = transform(end);
+
+#ifdef EZGL_USE_X11
+    if(!transparency_flag && x11_display != nullptr) {
+      segments.push_back({static_cast<short>(start.x), static_cast<short>(start.y), static_cast<short>(end.x),
+          static_cast<short>(end.y)});
+      continue;
+    }
+#endif
+
+    cairo_move_to(m_cairo, start.x, start.y);
+    cairo_line_to(m_cairo, end.x, end.y);
+  }
+
+  m_draw_call_counts.lines_drawn += drawn;
+  if(drawn == 0)
+    return;
+  m_draw_call_counts.strokes++;
+
+#ifdef EZGL_USE_X11
+  if(!transparency_flag && x11_display != nullptr) {
+    XDrawSegments(x11_display, x11_drawable, x11_context, segments.data(), segments.size());
+    return;
+  }
+#endif
+
   cairo_stroke(m_cairo);
 }
 
@@ -408,8 +575,11 @@ void renderer::fill_poly(std::vector<point2d> const &points)
     y_max = std::max(y_max, points[i].y);
   }
 
-  if(rectangle_off_screen({{x_min, y_min}, {x_max, y_max}}))
+  if(rectangle_off_screen({{x_min, y_min}, {x_max, y_max}})) {
+    m_draw_call_counts.polys_culled++;
     return;
+  }
+  m_draw_call_counts.polys_drawn++;
 
   point2d next_point = points[0];
 
@@ -455,6 +625,79 @@ void renderer::fill_poly(std::vector<point2d> const &points)
 
   cairo_close_path(m_cairo);
   cairo_fill(m_cairo);
+  m_draw_call_counts.strokes++;
+}
+
+void renderer::fill_polys(point2d const *points, int const *offsets, std::size_t num_polys)
+{
+  axis_transform transform = batch_transform();
+  std::size_t drawn = 0;
+
+  for(std::size_t k = 0; k < num_polys; ++k) {
+    point2d const *poly = points + offsets[k];
+    int count = offsets[k + 1] - offsets[k];
+    if(count < 2)
+      continue;
+
+    double x_min = poly[0].x;
+    double x_max = poly[0].x;
+    double y_min = poly[0].y;
+    double y_max = poly[0].y;
+    double twice_area = 0.0;
+
+    for(int i = 1; i < count; ++i) {
+      x_min = std::min(x_min, poly[i].x);
+      x_max = std::max(x_max, poly[i].x);
+      y_min = std::min(y_min, poly[i].y);
+      y_max = std::max(y_max, poly[i].y);
+      twice_area += (poly[i - 1].x - poly[0].x) * (poly[i].y - poly[0].y) -
+          (poly[i].x - poly[0].x) * (poly[i - 1].y - poly[0].y);
+    }
+
+    if(rectangle_off_screen({{x_min, y_min}, {x_max, y_max}})) {
+      m_draw_call_counts.polys_culled++;
+      continue;
+    }
+    drawn++;
+
+#ifdef EZGL_USE_X11
+    if(!transparency_flag && x11_display != nullptr) {
+      std::vector<XPoint> trans_points(count);
+      for(int i = 0; i < count; ++i) {
+        point2d next_point = transform(poly[i]);
+        trans_points[i].x = static_cast<long>(next_point.x);
+        trans_points[i].y = static_cast<long>(next_point.y);
+      }
+      XFillPolygon(x11_display, x11_drawable, x11_context, trans_points.data(), count, Complex, CoordModeOrigin);
+      m_draw_call_counts.strokes++;
+      continue;
+    }
+#endif
+
+    // every polygon is walked counter-clockwise so the non-zero winding rule fills overlaps instead of
+    // cutting holes where polygons of opposite orientations overlap
+    for(int i = 0; i < count; ++i) {
+      point2d next_point = transform(twice_area >= 0 ? poly[i] : poly[count - 1 - i]);
+      if(i == 0)
+        cairo_move_to(m_cairo, next_point.x, next_point.y);
+      else
+        cairo_line_to(m_cairo, next_point.x, next_point.y);
+    }
+    cairo_close_path(m_cairo);
+  }
+
+  m_draw_call_counts.polys_drawn += drawn;
+
+#ifdef EZGL_USE_X11
+  if(!transparency_flag && x11_display != nullptr)
+    return;
+#endif
+
+  if(drawn == 0)
+    return;
+
+  cairo_fill(m_cairo);
+  m_draw_call_counts.strokes++;
 }
 
 void renderer::draw_elliptic_arc(point2d center,
@@ -528,33 +771,63 @@ void renderer::draw_text(point2d point, std::string const &text, double bound_x,
   else if (vert_justification == justification::bottom)
     center.y += bound_y/2;
 
-  if(rectangle_off_screen({{center.x - bound_x / 2, center.y - bound_y / 2}, bound_x, bound_y}))
+  if(rectangle_off_screen({{center.x - bound_x / 2, center.y - bound_y / 2}, bound_x, bound_y})) {
+    m_draw_call_counts.texts_culled++;
     return;
+  }
 
   // get the width and height of the drawn text
-  cairo_text_extents_t text_extents{0,0,0,0,0,0};
-  cairo_text_extents(m_cairo, text.c_str(), &text_extents);
-
-  // get more information about the font used
-  cairo_font_extents_t font_extents{0,0,0,0,0};
-  cairo_font_extents(m_cairo, &font_extents);
+  text_extents extents = measure_text(text);
 
   // get text width and height in the current coordinate system to check against the bounds
   // Note: text width and height are constant in widget coordinates
   double scaled_width, scaled_height;
   if (current_coordinate_system == WORLD) {
-    scaled_width = text_extents.width * m_camera->get_world_scale_factor().x;
-    scaled_height = text_extents.height * m_camera->get_world_scale_factor().y;
+    scaled_width = extents.width * m_camera->get_world_scale_factor().x;
+    scaled_height = extents.height * m_camera->get_world_scale_factor().y;
   } else {  /* SCREEN coordinates */
-    scaled_width = text_extents.width;
-    scaled_height = text_extents.height;
+    scaled_width = extents.width;
+    scaled_height = extents.height;
   }
 
   // if text width or height is greater than the given bounds, don't draw the text.
   // NOTE: text rotation is NOT taken into account in bounding check (i.e. text width is compared to bound_x)
   if(scaled_width > bound_x || scaled_height > bound_y) {
+    m_draw_call_counts.texts_culled++;
     return;
   }
+  m_draw_call_counts.texts_drawn++;
+
+  show_text(point, text, extents);
+}
+
+renderer::text_extents renderer::measure_text(std::string const &text)
+{
+  cairo_text_extents_t cairo_text{0,0,0,0,0,0};
+  cairo_text_extents(m_cairo, text.c_str(), &cairo_text);
+
+  // get more information about the font used
+  cairo_font_extents_t font_extents{0,0,0,0,0};
+  cairo_font_extents(m_cairo, &font_extents);
+
+  text_extents extents;
+  extents.x_bearing = cairo_text.x_bearing;
+  extents.y_bearing = cairo_text.y_bearing;
+  extents.width = cairo_text.width;
+  extents.height = cairo_text.height;
+  extents.descent = font_extents.descent;
+  return extents;
+}
+
+void renderer::draw_text(point2d point, std::string const &text, text_extents const &extents)
+{
+  m_draw_call_counts.texts_drawn++;
+  show_text(point, text, extents);
+}
+
+void renderer::show_text(point2d point, std::string const &text, text_extents const &extents)
+{
+  point2d center;
 
   // save the current state to undo the rotation needed for drawing rotated text
   cairo_save(m_cairo);
@@ -570,29 +843,29 @@ void renderer::draw_text(point2d point, std::string const &text, double bound_x,
   point2d ref_point = {0, 0};
 
   ref_point.x = center.x -
-                (text_extents.x_bearing + (text_extents.width / 2)) * cos(rotation_angle) -
-                (-font_extents.descent + (text_extents.height / 2)) * sin(rotation_angle);
+                (extents.x_bearing + (extents.width / 2)) * cos(rotation_angle) -
+                (-extents.descent + (extents.height / 2)) * sin(rotation_angle);
 
   ref_point.y = center.y -
-                (text_extents.y_bearing + (text_extents.height / 2)) * cos(rotation_angle) -
-                (text_extents.x_bearing + (text_extents.width / 2)) * sin(rotation_angle);
+                (extents.y_bearing + (extents.height / 2)) * cos(rotation_angle) -
+                (extents.x_bearing + (extents.width / 2)) * sin(rotation_angle);
 
   // adjust the reference point according to the required justification
   if (horiz_justification == justification::left) {
-    ref_point.x += (text_extents.width / 2) * cos(rotation_angle);
-    ref_point.y += (text_extents.width / 2) * sin(rotation_angle);
+    ref_point.x += (extents.width / 2) * cos(rotation_angle);
+    ref_point.y += (extents.width / 2) * sin(rotation_angle);
   }
   else if (horiz_justification == justification::right) {
-    ref_point.x -= (text_extents.width / 2) * cos(rotation_angle);
-    ref_point.y -= (text_extents.width / 2) * sin(rotation_angle);
+    ref_point.x -= (extents.width / 2) * cos(rotation_angle);
+    ref_point.y -= (extents.width / 2) * sin(rotation_angle);
   }
   if (vert_justification == justification::top) {
-    ref_point.x -= (text_extents.height / 2) * sin(rotation_angle);
-    ref_point.y += (text_extents.height / 2) * cos(rotation_angle);
+    ref_point.x -= (extents.height / 2) * sin(rotation_angle);
+    ref_point.y += (extents.height / 2) * cos(rotation_angle);
   }
   else if (vert_justification == justification::bottom) {
-    ref_point.x += (text_extents.height / 2) * sin(rotation_angle);
-    ref_point.y -= (text_extents.height / 2) * cos(rotation_angle);
+    ref_point.x += (extents.height / 2) * sin(rotation_angle);
+    ref_point.y -= (extents.height / 2) * cos(rotation_angle);
   }
 
   // move to the reference point, perform the rotation, and draw the text
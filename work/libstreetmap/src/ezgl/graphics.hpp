@@ -198,6 +198,21 @@ public:
    */
   rectangle get_visible_world();
 
+  /**
+   * Set how far outside the visible world the pre-clipping keeps drawing, so lines just outside the edge still
+   * draw the part of their stroke that reaches into it (for images that are drawn in tiles or strips)
+   *
+   * @param margin The margin in world units, 0 by default
+   */
+  void set_cull_margin(double margin);
+
+  /**
+   * Get the visible world grown by the cull margin, the area the pre-clipping keeps
+   *
+   * @return A rectangle where rectangle.first is the lower left corner and rectangle.second is the upper right
+   */
+  rectangle get_cull_world();
+
   /**
    * Get the current visible bounds of the screen in pixel coordinates
    * 
@@ -324,6 +339,26 @@ public:
    */
   void draw_line(point2d start, point2d end);
 
+  /**
+   * Draw connected lines through the points, stroked once.
+   *
+   * @param points The points, in the current coordinate system
+   * @param count The number of points, nothing is drawn for less than 2
+   */
+  void draw_polyline(point2d const *points, std::size_t count);
+  void draw_polyline(std::vector<point2d> const &points);
+
+  /**
+   * Draw many separate lines with the current style, stroked once.
+   *
+   * The points are transformed in bulk and every line is pre-clipped on its own, which is much cheaper than
+   * calling draw_line for each line.
+   *
+   * @param points The start and end point of each line, one after the other, in the current coordinate system
+   * @param count The number of points (twice the number of lines)
+   */
+  void draw_lines(point2d const *points, std::size_t count);
+
   /**
    * Draw the outline a rectangle.
    *
@@ -382,6 +417,19 @@ public:
    */
   void fill_poly(std::vector<point2d> const &points);
 
+  /**
+   * Fill many polygons with the current colour, filled once.
+   *
+   * Polygon i is points[offsets[i]] to points[offsets[i + 1] - 1], with the same requirements as fill_poly. Each
+   * polygon is pre-clipped on its own and the polygons are all given the same orientation, so overlapping
+   * polygons are filled like separate fill_poly calls would be.
+   *
+   * @param points The points of all the polygons, in the current coordinate system
+   * @param offsets The first point of each polygon, num_polys + 1 entries
+   * @param num_polys The number of polygons
+   */
+  void fill_polys(point2d const *points, int const *offsets, std::size_t num_polys);
+
   /**
    * Draw the outline of an elliptic arc
    *
@@ -453,6 +501,35 @@ public:
    */
   void draw_text(point2d point, std::string const &text, double bound_x, double bound_y);
 
+  /**
+   * The size of a text drawn with the current font, in pixels (screen coordinates), as cairo measures it
+   */
+  struct text_extents {
+    double x_bearing = 0;
+    double y_bearing = 0;
+    double width = 0;
+    double height = 0;
+    double descent = 0; // of the font, not of the text
+  };
+
+  /**
+   * Measure a text with the current font and font size, without drawing it. The result can be kept and passed
+   * to draw_text as long as the font and font size do not change.
+   *
+   * @param text The text to measure
+   */
+  text_extents measure_text(std::string const &text);
+
+  /**
+   * Draw text already measured with measure_text, justified and rotated like the other draw_text calls. There is
+   * no bounds check and no pre-clipping: the caller decided the text is to be drawn.
+   *
+   * @param point The point where the text is drawn, in the current coordinate system
+   * @param text The text to draw
+   * @param extents The extents of the text with the current font
+   */
+  void draw_text(point2d point, std::string const &text, text_extents const &extents);
+
   /**
    * Draw a surface
    *
@@ -480,6 +557,36 @@ public:
    */
   static void free_surface(surface *surface);
 
+  /**
+   * Counts of the draw calls made on this renderer, split between the calls that were drawn and the calls
+   * dropped by the pre-clipping (off screen) or bound checks
+   */
+  struct draw_call_counts {
+    std::size_t lines_drawn = 0;
+    std::size_t lines_culled = 0;
+    std::size_t polys_drawn = 0;
+    std::size_t polys_culled = 0;
+    std::size_t texts_drawn = 0;
+    std::size_t texts_culled = 0;
+    std::size_t strokes = 0; // cairo strokes and fills of the line and polygon calls, batched calls count once
+  };
+
+  /**
+   * Get the counts of draw_line, fill_poly and draw_text calls since the renderer was created or since the last
+   * call to reset_draw_call_counts
+   */
+  draw_call_counts get_draw_call_counts() const;
+
+  /**
+   * Set all the draw call counts back to zero
+   */
+  void reset_draw_call_counts();
+
+  /**
+   * Add the counts of another renderer, for what it drew into an image this renderer draws
+   */
+  void add_draw_call_counts(const draw_call_counts &counts);
+
   /**
    * Destructor.
    */
@@ -523,6 +630,27 @@ private:
   // Pre-clipping function
   bool rectangle_off_screen(rectangle rect);
 
+  // Draw measured text at the point (in the current coordinate system), with the current justification and rotation
+  void show_text(point2d point, std::string const &text, text_extents const &extents);
+
+  // The transform of the current coordinate system as x' = sx * x + tx and y' = sy * y + ty, so the batched calls
+  // transform points without a std::function call each (world to screen is a scale and a translation per axis)
+  struct axis_transform {
+    double sx = 1.0, tx = 0.0, sy = 1.0, ty = 0.0;
+
+    point2d operator()(point2d p) const
+    {
+      return {sx * p.x + tx, sy * p.y + ty};
+    }
+  };
+  axis_transform batch_transform();
+
+  // Counts of the draw calls made on this renderer
+  draw_call_counts m_draw_call_counts;
+
+  // Margin of the pre-clipping around the visible world, in world units
+  double m_cull_margin = 0.0;
+
   // Current coordinate system (World is the default)
   t_coordinate_system current_coordinate_system = WORLD;
 
@@ -0,0 +1,199 @@
+//
+// Frame time profiler: per pass timers of the main canvas, renderer draw call counts,
+// an on-canvas overlay and a CSV dump of the last frames
+//
+
+#include "global.h"
+#include <fstream>
+#include <iomanip>
+
+// Initialize value here
+FrameProfiler frame_profiler;
+
+// number of frames kept for the rolling statistics and the CSV dump
+#define FRAME_HISTORY 240
+
+static const char* render_pass_names[NUM_RENDER_PASSES] = {
+    "features", "streets", "labels", "pois", "subway", "intersections", "tiles", "strips", "base_layer", "route"
+};
+
+static double elapsed_ms(std::chrono::high_resolution_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+// called first thing in draw_main_canvas_xy_fixed_world
+void begin_frame(ezgl::renderer* g) {
+    g->reset_draw_call_counts();
+    std::lock_guard<std::mutex> lock(frame_profiler.render_queue_mutex);
+    frame_profiler.current = FrameSample();
+    frame_profiler.frame_start = std::chrono::high_resolution_clock::now();
+}
+
+void begin_render_pass(RenderPass /*pass*/) {
+    frame_profiler.pass_start = std::chrono::high_resolution_clock::now();
+}
+
+// a pass may be split in several parts, the times are added
+void end_render_pass(RenderPass pass) {
+    frame_profiler.current.pass_ms[pass] += elapsed_ms(frame_profiler.pass_start);
+}
+
+// store the frame in the history, then draw the overlay on top if it is shown
+void end_frame(ezgl::renderer* g) {
+    frame_profiler.current.frame_ms = elapsed_ms(frame_profiler.frame_start);
+    frame_profiler.current.draw_calls = g->get_draw_call_counts();
+    FrameSample frame;
+    {
+        //the tile workers may still be adding their render queue counts
+        std::lock_guard<std::mutex> lock(frame_profiler.render_queue_mutex);
+        frame = frame_profiler.current;
+    }
+
+    if (frame_profiler.frames.size() < FRAME_HISTORY) {
+        frame_profiler.frames.push_back(frame);
+    } else {
+        frame_profiler.frames[frame_profiler.next_frame] = frame;
+    }
+    frame_profiler.next_frame = (frame_profiler.next_frame + 1) % FRAME_HISTORY;
+    frame_profiler.num_frames++;
+
+    if (frame_profiler.show_overlay) {
+        draw_profiler_overlay(g);
+    }
+}
+
+// mean, 95th percentile and max of the frame times in the history
+FrameTimeStats frame_time_stats() {
+    FrameTimeStats stats;
+    if (frame_profiler.frames.empty()) {
+        return stats;
+    }
+
+    std::vector<double> times;
+    times.reserve(frame_profiler.frames.size());
+    for (int i = 0; i < frame_profiler.frames.size(); ++i) {
+        times.push_back(frame_profiler.frames[i].frame_ms);
+        stats.mean_ms += frame_profiler.frames[i].frame_ms;
+    }
+    stats.mean_ms /= times.size();
+
+    int p95 = (times.size() - 1) * 95 / 100;
+    std::nth_element(times.begin(), times.begin() + p95, times.end());
+    stats.p95_ms = times[p95];
+    stats.max_ms = *std::max_element(times.begin() + p95, times.end());
+    return stats;
+}
+
+// text box in the top left corner of the canvas with the last frame and the rolling statistics
+void draw_profiler_overlay(ezgl::renderer* g) {
+    FrameSample frame;
+    {
+        std::lock_guard<std::mutex> lock(frame_profiler.render_queue_mutex);
+        frame = frame_profiler.current;
+    }
+    FrameTimeStats stats = frame_time_stats();
+
+    std::vector<std::string> lines;
+    std::ostringstream line;
+    line << std::fixed << std::setprecision(2);
+
+    line << "frame " << frame.frame_ms << " ms  (mean " << stats.mean_ms << ", p95 " << stats.p95_ms
+         << ", max " << stats.max_ms << " over " << frame_profiler.frames.size() << ")";
+    lines.push_back(line.str());
+    for (int pass = 0; pass < NUM_RENDER_PASSES; ++pass) {
+        line.str("");
+        line << "  " << render_pass_names[pass] << " " << frame.pass_ms[pass] << " ms";
+        lines.push_back(line.str());
+    }
+    line.str("");
+    line << "lines " << frame.draw_calls.lines_drawn << " drawn / " << frame.draw_calls.lines_culled << " culled";
+    lines.push_back(line.str());
+    line.str("");
+    line << "polys " << frame.draw_calls.polys_drawn << " drawn / " << frame.draw_calls.polys_culled << " culled";
+    lines.push_back(line.str());
+    line.str("");
+    line << "texts " << frame.draw_calls.texts_drawn << " drawn / " << frame.draw_calls.texts_culled << " culled";
+    lines.push_back(line.str());
+    line.str("");
+    line << "strokes and fills " << frame.draw_calls.strokes;
+    lines.push_back(line.str());
+    line.str("");
+    line << "queue " << frame.render_queue.commands << " commands in " << frame.render_queue.batches
+         << " batches, " << frame.render_queue.state_changes << " state changes ("
+         << frame.render_queue.style_changes - frame.render_queue.state_changes << " saved)";
+    lines.push_back(line.str());
+
+    const double line_height = 16;
+    g->set_coordinate_system(ezgl::SCREEN);
+    g->set_color(0, 0, 0, 170);
+    g->fill_rectangle({10, 10}, 420, line_height * lines.size() + 10);
+
+    g->set_color(ezgl::WHITE);
+    g->set_font_size(12);
+    g->set_horiz_justification(ezgl::justification::left);
+    g->set_vert_justification(ezgl::justification::top);
+    for (int i = 0; i < lines.size(); ++i) {
+        g->draw_text({18, 15 + line_height * i}, lines[i]);
+    }
+
+    g->set_horiz_justification(ezgl::justification::center);
+    g->set_vert_justification(ezgl::justification::center);
+    g->set_coordinate_system(ezgl::WORLD);
+}
+
+// write the frames of the history, oldest first, returns false if the file can not be opened
+bool dump_profiler_csv(const std::string& path) {
+    std::ofstream csv(path);
+    if (!csv) {
+        return false;
+    }
+
+    csv << "frame,frame_ms";
+    for (int pass = 0; pass < NUM_RENDER_PASSES; ++pass) {
+        csv << "," << render_pass_names[pass] << "_ms";
+    }
+    csv << ",lines_drawn,lines_culled,polys_drawn,polys_culled,texts_drawn,texts_culled,strokes";
+    csv << ",queue_commands,queue_batches,style_changes,state_changes\n";
+
+    int count = frame_profiler.frames.size();
+    int oldest = (count < FRAME_HISTORY) ? 0 : frame_profiler.next_frame;
+    for (int i = 0; i < count; ++i) {
+        const FrameSample& frame = frame_profiler.frames[(oldest + i) % count];
+        csv << frame_profiler.num_frames - count + i << "," << frame.frame_ms;
+        for (int pass = 0; pass < NUM_RENDER_PASSES; ++pass) {
+            csv << "," << frame.pass_ms[pass];
+        }
+        csv << "," << frame.draw_calls.lines_drawn << "," << frame.draw_calls.lines_culled
+            << "," << frame.draw_calls.polys_drawn << "," << frame.draw_calls.polys_culled
+            << "," << frame.draw_calls.texts_drawn << "," << frame.draw_calls.texts_culled
+            << "," << frame.draw_calls.strokes << "," << frame.render_queue.commands
+            << "," << frame.render_queue.batches << "," << frame.render_queue.style_changes
+            << "," << frame.render_queue.state_changes << "\n";
+    }
+    return true;
+}
+
+// called by flush_render_queue, on the GTK thread or a tile worker
+void add_render_queue_stats(const RenderQueueStats& stats) {
+    std::lock_guard<std::mutex> lock(frame_profiler.render_queue_mutex);
+    RenderQueueStats& frame = frame_profiler.current.render_queue;
+    frame.commands += stats.commands;
+    frame.batches += stats.batches;
+    frame.style_changes += stats.style_changes;
+    frame.state_changes += stats.state_changes;
+}
+
+// "Profiler" button: show or hide the overlay
+void toggle_profiler_overlay(GtkWidget* /*widget*/, ezgl::application* application) {
+    frame_profiler.show_overlay = !frame_profiler.show_overlay;
+    application->refresh_drawing();
+}
+
+// "Profiler CSV" button: dump the history next to the executable
+void dump_profiler_csv_button(GtkWidget* /*widget*/, ezgl::application* application) {
+    if (dump_profiler_csv("frame_profile.csv")) {
+        application->update_message("Frame profile written to frame_profile.csv");
+    } else {
+        application->update_message("Could not write frame_profile.csv");
+    }
+}
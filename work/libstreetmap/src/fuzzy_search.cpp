@@ -0,0 +1,391 @@
+//
+// Fuzzy (typo tolerant) name search for streets, intersections and POIs, with a query latency benchmark
+//
+
+#include "global.h"
+#include <random>
+
+// Initialize value here
+FuzzyNameIndex street_name_index;
+FuzzyNameIndex intersection_name_index;
+FuzzyNameIndex poi_name_index;
+
+// only the first characters of a name are put in the trigram index,
+// this keeps the index small on maps with lots of long intersection names
+#define FUZZY_INDEXED_PREFIX 16
+// padding character put in front of a name so the first letters get their own trigrams
+#define FUZZY_PAD '\1'
+
+// lower case and remove the spaces, same rule as findStreetIdsFromPartialStreetName
+std::string normalize_name(std::string name) {
+    name.erase(std::remove_if(name.begin(), name.end(),
+                              [](unsigned char c) { return std::isspace(c); }), name.end());
+    std::transform(name.begin(), name.end(), name.begin(),
+                   [](unsigned char c) { return std::tolower(c); });
+    return name;
+}
+
+// pack the trigram that ends at position pos of the padded name into one key
+static unsigned trigram_key(const std::string& name, int pos) {
+    unsigned char c0 = (pos >= 2) ? name[pos - 2] : FUZZY_PAD;
+    unsigned char c1 = (pos >= 1) ? name[pos - 1] : FUZZY_PAD;
+    unsigned char c2 = name[pos];
+    return (c0 << 16) | (c1 << 8) | c2;
+}
+
+// the maximum number of typos we accept for a query of this length
+static int max_edits_for_length(int length) {
+    if (length <= 3) return 0;
+    if (length <= 6) return 1;
+    return 2;
+}
+
+// edit distance between the query and the closest prefix of name, only computed inside the
+// band |i - j| <= max_edits; returns max_edits + 1 as soon as the distance is known to be larger
+static int bounded_prefix_distance(const std::string& query, const std::string& name, int max_edits,
+                                   std::vector<int>& prev, std::vector<int>& curr) {
+    int m = query.size();
+    int n = std::min<int>(name.size(), m + max_edits);
+    int too_far = max_edits + 1;
+
+    if (n < m - max_edits) {
+        return too_far;
+    }
+
+    prev.assign(n + 2, too_far);
+    curr.assign(n + 2, too_far);
+    for (int j = 0; j <= std::min(n, max_edits); ++j) {
+        prev[j] = j;
+    }
+
+    for (int i = 1; i <= m; ++i) {
+        int lo = std::max(1, i - max_edits);
+        int hi = std::min(n, i + max_edits);
+        curr[lo - 1] = (lo == 1) ? std::min(i, too_far) : too_far;
+        int row_min = curr[lo - 1];
+
+        for (int j = lo; j <= hi; ++j) {
+            int substitute = prev[j - 1] + (query[i - 1] != name[j - 1]);
+            int remove = prev[j] + 1;
+            int insert = curr[j - 1] + 1;
+            curr[j] = std::min(too_far, std::min(substitute, std::min(remove, insert)));
+            row_min = std::min(row_min, curr[j]);
+        }
+        curr[hi + 1] = too_far;
+
+        // every cell of this row is already too far, the next rows can only be worse
+        if (row_min > max_edits) {
+            return too_far;
+        }
+        std::swap(prev, curr);
+    }
+
+    int best = too_far;
+    for (int j = std::max(0, m - max_edits); j <= n; ++j) {
+        best = std::min(best, prev[j]);
+    }
+    return best;
+}
+
+// build the index from the raw names, raw_names[id] is the name of id
+void build_fuzzy_index(FuzzyNameIndex& index, const std::vector<std::string>& raw_names) {
+    index = FuzzyNameIndex();
+
+    // sort <normalized name, id> so equal names end up next to each other
+    std::vector<std::pair<std::string, int>> name_id(raw_names.size());
+    for (int id = 0; id < raw_names.size(); ++id) {
+        name_id[id] = std::make_pair(normalize_name(raw_names[id]), id);
+    }
+    std::sort(name_id.begin(), name_id.end());
+
+    // one entry per distinct name, the ids of a name are stored one after the other
+    for (int i = 0; i < name_id.size(); ++i) {
+        if (index.names.empty() || index.names.back() != name_id[i].first) {
+            index.names.push_back(name_id[i].first);
+            index.id_offsets.push_back(index.ids.size());
+        }
+        index.ids.push_back(name_id[i].second);
+    }
+    index.id_offsets.push_back(index.ids.size());
+
+    // <trigram, name> pairs packed in one integer so a single sort groups them by trigram
+    std::vector<unsigned long long> gram_name;
+    gram_name.reserve(index.names.size() * FUZZY_INDEXED_PREFIX);
+    for (int i = 0; i < index.names.size(); ++i) {
+        int length = std::min<int>(index.names[i].size(), FUZZY_INDEXED_PREFIX);
+        for (int pos = 0; pos < length; ++pos) {
+            gram_name.push_back(((unsigned long long) trigram_key(index.names[i], pos) << 32) | i);
+        }
+    }
+    std::sort(gram_name.begin(), gram_name.end());
+    gram_name.erase(std::unique(gram_name.begin(), gram_name.end()), gram_name.end());
+
+    // postings of grams[g] are postings[gram_offsets[g] .. gram_offsets[g+1])
+    index.postings.reserve(gram_name.size());
+    for (int i = 0; i < gram_name.size(); ++i) {
+        unsigned gram = gram_name[i] >> 32;
+        if (index.grams.empty() || index.grams.back() != gram) {
+            index.grams.push_back(gram);
+            index.gram_offsets.push_back(index.postings.size());
+        }
+        index.postings.push_back(gram_name[i] & 0xffffffff);
+    }
+    index.gram_offsets.push_back(index.postings.size());
+}
+
+// all ids whose normalized name starts with the normalized prefix, in increasing order
+std::vector<int> find_prefix_matches(const FuzzyNameIndex& index, const std::string& prefix) {
+    std::vector<int> result;
+
+    auto it = std::lower_bound(index.names.begin(), index.names.end(), prefix);
+    for (int i = it - index.names.begin(); i < index.names.size(); ++i) {
+        if (index.names[i].compare(0, prefix.size(), prefix) != 0) {
+            break;
+        }
+        result.insert(result.end(), index.ids.begin() + index.id_offsets[i],
+                      index.ids.begin() + index.id_offsets[i + 1]);
+    }
+    std::sort(result.begin(), result.end());
+    return result;
+}
+
+// search one index, matches are appended to results
+static void search_fuzzy_index(const FuzzyNameIndex& index, SearchKind kind, const std::string& query,
+                               int max_results, std::vector<SearchResult>& results) {
+    int query_edits = max_edits_for_length(query.size()); //typos accepted for the query, picks the candidates
+    int max_edits = query_edits; //tightened while checking the candidates
+    std::vector<int> candidates;
+
+    if (query_edits == 0) {
+        // short queries: exact prefixes only, found with the sorted names
+        auto it = std::lower_bound(index.names.begin(), index.names.end(), query);
+        for (int i = it - index.names.begin(); i < index.names.size(); ++i) {
+            if (index.names[i].compare(0, query.size(), query) != 0) {
+                break;
+            }
+            candidates.push_back(i);
+        }
+    } else {
+        // an edit can only break the 3 trigrams that cover it, and the edits can shift the
+        // later ones by up to max_edits characters, so only query trigrams that still land
+        // inside the indexed part of the names are counted
+        int usable = std::min<int>(query.size(), FUZZY_INDEXED_PREFIX - max_edits);
+        std::vector<unsigned> query_grams;
+        for (int pos = 0; pos < usable; ++pos) {
+            query_grams.push_back(trigram_key(query, pos));
+        }
+        std::sort(query_grams.begin(), query_grams.end());
+        query_grams.erase(std::unique(query_grams.begin(), query_grams.end()), query_grams.end());
+
+        // a match shares at least threshold trigrams with the query, so it has to be in at
+        // least one of the (query_grams.size() - threshold + 1) rarest posting lists;
+        // the very common trigrams (e.g. "str", "eet") never need to be scanned
+        int threshold = std::max<int>(1, query_grams.size() - 3 * max_edits);
+        std::vector<std::pair<int, int>> lists; //<posting list length, gram>
+        for (int g = 0; g < query_grams.size(); ++g) {
+            auto it = std::lower_bound(index.grams.begin(), index.grams.end(), query_grams[g]);
+            if (it == index.grams.end() || *it != query_grams[g]) {
+                lists.push_back(std::make_pair(0, -1));
+                continue;
+            }
+            int gram = it - index.grams.begin();
+            lists.push_back(std::make_pair(index.gram_offsets[gram + 1] - index.gram_offsets[gram], gram));
+        }
+        std::sort(lists.begin(), lists.end());
+
+        std::vector<bool> seen(index.names.size(), false);
+        for (int l = 0; l < (int) lists.size() - threshold + 1; ++l) {
+            int gram = lists[l].second;
+            if (gram == -1) {
+                continue;
+            }
+            for (int p = index.gram_offsets[gram]; p < index.gram_offsets[gram + 1]; ++p) {
+                int name = index.postings[p];
+                if (!seen[name]) {
+                    seen[name] = true;
+                    candidates.push_back(name);
+                }
+            }
+        }
+    }
+
+    // check the candidates with the real edit distance; once max_results ids are found within
+    // some distance, anything further away can never be ranked, so the bound is tightened
+    std::vector<int> prev, curr;
+    std::vector<int> found(max_edits + 1, 0); //ids found at each distance
+    for (int i = 0; i < candidates.size(); ++i) {
+        const std::string& name = index.names[candidates[i]];
+        // the exact prefix candidates are all at distance 0, the trigram ones only share trigrams with the
+        // query, so they are still checked once the bound is tightened to 0
+        int distance = 0;
+        if (max_edits > 0) {
+            distance = bounded_prefix_distance(query, name, max_edits, prev, curr);
+        } else if (query_edits > 0 && name.compare(0, query.size(), query) != 0) {
+            continue;
+        }
+        if (distance > max_edits) {
+            continue;
+        }
+
+        found[distance] += index.id_offsets[candidates[i] + 1] - index.id_offsets[candidates[i]];
+        int total = 0;
+        for (int d = 0; d < max_edits; ++d) {
+            total += found[d];
+            if (total >= max_results) {
+                max_edits = d;
+                break;
+            }
+        }
+
+        bool exact = (distance == 0) && (name.size() == query.size());
+        for (int k = index.id_offsets[candidates[i]]; k < index.id_offsets[candidates[i] + 1]; ++k) {
+            results.push_back({kind, index.ids[k], distance, exact, (int) name.size()});
+        }
+    }
+}
+
+// ranked typo tolerant search over the indexes selected by kinds (a mask of SearchKind)
+// best results first: fewer typos, then exact names, then shorter names
+std::vector<SearchResult> fuzzySearch(std::string query, int kinds, int max_results) {
+    std::vector<SearchResult> results;
+    query = normalize_name(query);
+    if (query.empty() || max_results <= 0) {
+        return results;
+    }
+
+    if (kinds & SEARCH_STREET) {
+        search_fuzzy_index(street_name_index, SEARCH_STREET, query, max_results, results);
+    }
+    if (kinds & SEARCH_INTERSECTION) {
+        search_fuzzy_index(intersection_name_index, SEARCH_INTERSECTION, query, max_results, results);
+    }
+    if (kinds & SEARCH_POI) {
+        search_fuzzy_index(poi_name_index, SEARCH_POI, query, max_results, results);
+    }
+
+    auto better = [](const SearchResult& lhs, const SearchResult& rhs) {
+        if (lhs.distance != rhs.distance) return lhs.distance < rhs.distance;
+        if (lhs.exact != rhs.exact) return lhs.exact;
+        if (lhs.name_length != rhs.name_length) return lhs.name_length < rhs.name_length;
+        if (lhs.kind != rhs.kind) return lhs.kind < rhs.kind;
+        return lhs.id < rhs.id;
+    };
+
+    if (results.size() > max_results) {
+        std::partial_sort(results.begin(), results.begin() + max_results, results.end(), better);
+        results.resize(max_results);
+    } else {
+        std::sort(results.begin(), results.end(), better);
+    }
+    return results;
+}
+
+// street ids that start with the prefix; if the user made a typo and nothing starts with it,
+// the closest fuzzy matches are returned instead. Returns {-1} when nothing is close enough
+std::vector<StreetIdx> find_street_ids_with_typos(std::string street_prefix) {
+    std::vector<StreetIdx> street_ids = findStreetIdsFromPartialStreetName(street_prefix);
+    if (street_ids[0] != -1) {
+        return street_ids;
+    }
+
+    std::vector<SearchResult> matches = fuzzySearch(street_prefix, SEARCH_STREET, 10);
+    if (matches.empty()) {
+        return street_ids;
+    }
+
+    std::vector<StreetIdx>().swap(street_ids);
+    for (int i = 0; i < matches.size(); ++i) {
+        street_ids.push_back(matches[i].id);
+    }
+    return street_ids;
+}
+
+// build all name indexes, called from loadMap
+void load_fuzzy_search_index() {
+    std::vector<std::string> raw_names(getNumStreets());
+    for (int i = 0; i < raw_names.size(); ++i) {
+        raw_names[i] = getStreetName(i);
+    }
+    build_fuzzy_index(street_name_index, raw_names);
+
+    raw_names.resize(getNumIntersections());
+    for (int i = 0; i < raw_names.size(); ++i) {
+        raw_names[i] = getIntersectionName(i);
+    }
+    build_fuzzy_index(intersection_name_index, raw_names);
+
+    raw_names.resize(getNumPointsOfInterest());
+    for (int i = 0; i < raw_names.size(); ++i) {
+        raw_names[i] = getPOIName(i);
+    }
+    build_fuzzy_index(poi_name_index, raw_names);
+}
+
+void clear_fuzzy_search_index() {
+    street_name_index = FuzzyNameIndex();
+    intersection_name_index = FuzzyNameIndex();
+    poi_name_index = FuzzyNameIndex();
+}
+
+// a query made from a name of the index: a prefix of 3 to 12 characters, with a typo in half of them
+static std::string benchmark_query(const FuzzyNameIndex& index, std::mt19937& random) {
+    const std::string& name = index.names[random() % index.names.size()];
+    std::string query = name.substr(0, 3 + random() % 10);
+    if (query.size() > 3 && random() % 2 == 0) {
+        int pos = random() % query.size();
+        switch (random() % 3) {
+            case 0: query[pos] = 'a' + random() % 26; break; //substitution
+            case 1: query.erase(pos, 1); break; //deletion
+            default: if (pos + 1 < query.size()) std::swap(query[pos], query[pos + 1]); break; //transposition
+        }
+    }
+    return query;
+}
+
+// time num_queries fuzzySearch calls over all three indexes with queries made from the names of the
+// loaded map, and print the latency percentiles, the target is a p99 under a millisecond
+void benchmark_fuzzy_search(int num_queries) {
+    std::vector<const FuzzyNameIndex*> indexes;
+    for (const FuzzyNameIndex* index : {&street_name_index, &intersection_name_index, &poi_name_index}) {
+        if (!index->names.empty()) {
+            indexes.push_back(index);
+        }
+    }
+    if (indexes.empty() || num_queries <= 0) {
+        std::cout << "benchmark_fuzzy_search: no map loaded" << std::endl;
+        return;
+    }
+
+    // the same queries every run on the same map
+    std::mt19937 random(297);
+    std::vector<std::string> queries(num_queries);
+    for (int i = 0; i < num_queries; ++i) {
+        queries[i] = benchmark_query(*indexes[i % indexes.size()], random);
+    }
+
+    std::vector<double> query_ms(num_queries);
+    long long num_results = 0;
+    for (int i = 0; i < num_queries; ++i) {
+        auto start = std::chrono::high_resolution_clock::now();
+        std::vector<SearchResult> results = fuzzySearch(queries[i], SEARCH_STREET | SEARCH_INTERSECTION | SEARCH_POI, 10);
+        std::chrono::duration<double, std::milli> elapsed = std::chrono::high_resolution_clock::now() - start;
+        query_ms[i] = elapsed.count();
+        num_results += results.size();
+    }
+
+    std::sort(query_ms.begin(), query_ms.end());
+    double mean_ms = 0.0;
+    for (double ms : query_ms) {
+        mean_ms += ms;
+    }
+    mean_ms /= num_queries;
+    double p99_ms = query_ms[(num_queries - 1) * 99 / 100];
+
+    std::cout << "fuzzy search, " << num_queries << " queries over " << street_name_index.names.size() << " street, "
+              << intersection_name_index.names.size() << " intersection and " << poi_name_index.names.size()
+              << " POI names" << std::endl;
+    std::cout << "  mean " << mean_ms << " ms, p50 " << query_ms[(num_queries - 1) / 2] << " ms, p95 "
+              << query_ms[(num_queries - 1) * 95 / 100] << " ms, p99 " << p99_ms << " ms, max " << query_ms.back()
+              << " ms" << std::endl;
+    std::cout << "  p99 " << (p99_ms < 1.0 ? "under" : "OVER") << " 1 ms (" << num_results << " results)" << std::endl;
+}
@@ -33,6 +33,9 @@
 #include "list"
 #include <queue>
 #include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
 
 //m4.cpp
 #include <chrono>
@@ -43,17 +46,117 @@
 
 #include <cstdlib> // For std::rand and std::srand
 #include <ctime>   // For std::ti
+//m1.cpp
+// read-only view of one row of a CompactAdjacency, handed out without copying
+template <typename T>
+struct IndexSpan {
+    const T* first;
+    const T* last;
+
+    const T* begin() const { return first; }
+    const T* end() const { return last; }
+    int size() const { return last - first; }
+    bool empty() const { return first == last; }
+    const T& operator[](int i) const { return first[i]; }
+};
+
+// flat (CSR) storage for a list per id: row i is values[offsets[i]] to values[offsets[i + 1] - 1]
+template <typename T>
+struct CompactAdjacency {
+    std::vector<int> offsets; //size is the number of rows + 1
+    std::vector<T> values;
+
+    IndexSpan<T> operator[](int row) const {
+        return {values.data() + offsets[row], values.data() + offsets[row + 1]};
+    }
+    int size() const { return offsets.empty() ? 0 : offsets.size() - 1; }
+};
+
+// open addressing (linear probing) hash from an OSMID to the entity's index in the OSM database
+struct OSMIdIndex {
+    std::vector<OSMID> slot_ids;
+    std::vector<int> slot_index; //-1 marks an empty slot
+    int shift; //64 - log2(number of slots)
+};
+
+// per street segment geometry filled once in loadMap, one array per field (indexed by StreetSegmentIdx)
+struct SegmentGeometryTable {
+    std::vector<double> length; //meters
+    std::vector<double> travel_time; //seconds at the speed limit
+    std::vector<double> start_bearing; //radians from east, leaving the from intersection
+    std::vector<double> end_bearing; //radians from east, arriving at the to intersection
+    std::vector<double> min_lat; //bounding box of the segment and its curve points
+    std::vector<double> max_lat;
+    std::vector<double> min_lon;
+    std::vector<double> max_lon;
+    std::vector<StreetIdx> street_id;
+    std::vector<IntersectionIdx> from;
+    std::vector<IntersectionIdx> to;
+};
+
+//distance_kernels.cpp
+// coordinates of many points as arrays (radians) for the batch distance kernels,
+// with the sin/cos of half the latitude so no kernel needs to call cos
+struct PointArray {
+    std::vector<double> lat;
+    std::vector<double> lon;
+    std::vector<double> cos_half_lat;
+    std::vector<double> sin_half_lat;
+};
+
+//projected_geometry.cpp
+// constants of the projection from LatLon to the world x/y the map is drawn in
+struct MapProjection {
+    double cos_avg_lat;
+    double x_per_degree; //x = longitude * x_per_degree
+    double y_per_degree; //y = latitude * y_per_degree
+};
+
+// one projected x/y point per id
+struct ProjectedPoints {
+    std::vector<double> x;
+    std::vector<double> y;
+};
+
+// projected polylines, row i is x/y[offsets[i] .. offsets[i+1])
+struct ProjectedPolylines {
+    std::vector<int> offsets;
+    std::vector<double> x;
+    std::vector<double> y;
+};
+
+// per feature metadata filled once in loadMap, one array per field (indexed by FeatureIdx)
+struct FeatureMetadataTable {
+    std::vector<double> area; //square meters, 0 if the feature is not a closed polygon
+    std::vector<double> min_x; //bounding box in world x/y
+    std::vector<double> max_x;
+    std::vector<double> min_y;
+    std::vector<double> max_y;
+    std::vector<double> centroid_x;
+    std::vector<double> centroid_y;
+    std::vector<char> closed; //first point == last point with at least 3 points (char, filled in parallel)
+    std::vector<int> num_points;
+    std::vector<double> draw_size; //area, or longest bounding box side squared if open (draw order and cutoff)
+};
+
 /*******************************declare vector*********************************/
 //m1.cpp
 extern double max_speed;
-extern std::vector<std::vector<StreetSegmentIdx>> intersection_street_segments;
-extern std::vector<std::vector<IntersectionIdx>> street_intersections;
+extern CompactAdjacency<StreetSegmentIdx> intersection_street_segments;
+extern CompactAdjacency<IntersectionIdx> street_intersections;
 extern std::vector<std::vector<StreetSegmentIdx>> street_segments;
+extern SegmentGeometryTable segment_geometry;
+extern std::vector<double> street_length;
 extern std::vector<std::vector<StreetIdx>> intersection_street_id;
 extern std::vector<const OSMNode*> NodeIndex_NodeId;
 extern std::vector<OSMID> NodeIndex_OSMId;
 extern std::vector<const OSMWay*> WayIndex_WayId;
 extern std::vector<OSMID> WayIndex_OSMId;
+extern std::vector<const OSMRelation*> RelationIndex_RelationId;
+extern std::vector<OSMID> RelationIndex_OSMId;
+extern OSMIdIndex node_osmid_index;
+extern OSMIdIndex way_osmid_index;
+extern OSMIdIndex relation_osmid_index;
 extern std::vector<std::vector<LatLon>> Way_LatLon_of_Nodes;
 extern std::vector<std::vector<double>> Way_WayLength;
 
@@ -66,6 +169,13 @@ struct Intersection_data {
     bool highlight = false;
 };
 
+// the toggles the map base is drawn with, copied from pinkify and subway_show on the GTK thread
+// so worker threads never read the toggles while they change
+struct MapStyle {
+    bool pinkify = false;
+    bool subway_show = false;
+};
+
 //m3.cpp
 //initialize the variables here
 // struct to store find path data
@@ -86,6 +196,394 @@ struct CompareWaveElem {
     }
 };
 
+//fuzzy_search.cpp
+// struct to store the trigram index of one kind of names (streets, intersections or POIs)
+struct FuzzyNameIndex {
+    std::vector<std::string> names; //distinct normalized names, sorted
+    std::vector<int> id_offsets; //ids of names[i] are ids[id_offsets[i] .. id_offsets[i+1])
+    std::vector<int> ids;
+    std::vector<unsigned> grams; //distinct trigrams, sorted
+    std::vector<int> gram_offsets; //names of grams[g] are postings[gram_offsets[g] .. gram_offsets[g+1])
+    std::vector<int> postings;
+};
+
+enum SearchKind {
+    SEARCH_STREET = 1,
+    SEARCH_INTERSECTION = 2,
+    SEARCH_POI = 4
+};
+
+// struct to store one fuzzy search match
+struct SearchResult {
+    SearchKind kind;
+    int id; //StreetIdx, IntersectionIdx or POIIdx depending on kind
+    int distance; //number of typos between the query and the name
+    bool exact; //the whole name matches the query
+    int name_length;
+};
+
+//osm_tags.cpp
+// every distinct tag key and value string, stored once and referred to by its id
+struct OSMStringPool {
+    std::vector<std::string> strings;
+    std::unordered_map<std::string, int> ids;
+};
+
+// tags of one kind of OSM entity in columns: the tags of entity i are
+// key_ids/value_ids[offsets[i] .. offsets[i+1]), sorted by key id
+struct OSMTagTable {
+    std::vector<int> offsets;
+    std::vector<int> key_ids;
+    std::vector<int> value_ids;
+};
+
+enum OSMEntityKind {
+    OSM_NODE,
+    OSM_WAY,
+    OSM_RELATION
+};
+
+// one OSM layer for the tag query engine: the entities of one kind that have the tag key=value
+struct OSMTagQuery {
+    OSMEntityKind kind;
+    std::string key;
+    std::string value; //empty matches any value
+    std::vector<int> matches; //entity indices in the OSM database, in order
+};
+
+// layers loaded from the OSM database by load_osm_layers, osm_layer_queries maps each to its tag query
+enum OSMLayer {
+    SUBWAY_STATION_LAYER,
+    TOILET_LAYER,
+    TOILET_WHEELCHAIR_LAYER,
+    SUBWAY_RAIL_LAYER,
+    NUM_OSM_LAYERS
+};
+
+//render_queue.cpp
+// draw order of the render queue, commands of a lower layer are drawn first
+enum DrawLayer {
+    PARK_DRAW_LAYER = 0,
+    BUILDING_DRAW_LAYER,
+    LAKE_DRAW_LAYER,
+    RIVER_DRAW_LAYER,
+    ISLAND_DRAW_LAYER,
+    BEACH_DRAW_LAYER,
+    GREENSPACE_DRAW_LAYER,
+    GOLFCOURSE_DRAW_LAYER,
+    GLACIER_DRAW_LAYER,
+    STREAM_DRAW_LAYER,
+    MINOR_STREET_DRAW_LAYER,
+    MAJOR_STREET_DRAW_LAYER,
+    HIGHWAY_DRAW_LAYER,
+    SUBWAY_DRAW_LAYER
+};
+
+struct RenderStyle {
+    ezgl::color color;
+    int line_width = 1;
+};
+
+enum RenderCommandKind {
+    LINES_COMMAND = 0,
+    POLYGON_COMMAND
+};
+
+// one recorded draw call, its points are points[first] to points[first + count - 1] of the queue
+struct RenderCommand {
+    int layer = 0;
+    int style = 0;
+    RenderCommandKind kind = LINES_COMMAND;
+    int first = 0;
+    int count = 0;
+};
+
+struct RenderQueueStats {
+    size_t commands = 0; //recorded draw calls
+    size_t batches = 0; //renderer calls they were drawn with
+    size_t style_changes = 0; //colour and line width changes drawing in recording order would have made
+    size_t state_changes = 0; //colour and line width changes made
+};
+
+struct RenderQueue {
+    std::vector<RenderStyle> styles; //every style seen, commands refer to them by index
+    std::vector<RenderCommand> commands;
+    std::vector<ezgl::point2d> points;
+    int current_layer = 0;
+    int current_style = -1;
+    RenderQueueStats stats;
+};
+
+//label_placement.cpp
+#define STREET_LABEL_FONT_SIZE 10
+#define POI_LABEL_FONT_SIZE 12
+// street names are not tried on segments shorter than this on screen
+#define STREET_LABEL_MIN_PIXELS 24
+// label priorities: points of interest, then highways, then the other streets by segment length
+#define POI_LABEL_PRIORITY 2e9
+#define HIGHWAY_LABEL_PRIORITY 1e9
+
+struct LabelTextKey {
+    std::string text;
+    int font_size = 0;
+
+    bool operator==(const LabelTextKey& other) const {
+        return font_size == other.font_size && text == other.text;
+    }
+};
+
+struct LabelTextKeyHash {
+    size_t operator()(const LabelTextKey& key) const {
+        return std::hash<std::string>()(key.text) ^ (size_t(key.font_size) << 1);
+    }
+};
+
+// a label that may be drawn this frame, the text must live until the labels are drawn
+struct LabelCandidate {
+    const std::string* text = nullptr;
+    ezgl::point2d position = {0, 0}; //world point the text is centered on
+    double angle = 0.0; //degrees, counterclockwise
+    int font_size = STREET_LABEL_FONT_SIZE;
+    ezgl::color color = ezgl::BLACK;
+    double priority = 0.0;
+};
+
+// screen box of a placed label, in pixels from the top left of the canvas
+struct LabelBox {
+    double left = 0.0;
+    double right = 0.0;
+    double top = 0.0;
+    double bottom = 0.0;
+};
+
+struct LabelEngine {
+    std::unordered_map<LabelTextKey, ezgl::renderer::text_extents, LabelTextKeyHash> text_cache;
+    size_t texts_measured = 0; //cache misses since the map was loaded
+    std::vector<std::string> street_names; //by StreetIdx, so candidates can point at them
+
+    std::vector<LabelCandidate> candidates;
+    std::vector<LabelBox> placed;
+    std::vector<std::vector<int>> cells; //collision grid, placed labels touching each cell
+    int num_cols = 0;
+    int num_rows = 0;
+    double pixels_per_world = 1.0;
+    double world_left = 0.0;
+    double world_top = 0.0;
+    double screen_width = 0.0;
+    double screen_height = 0.0;
+};
+
+//frame_profiler.cpp
+// the timed passes of draw_main_canvas_xy_fixed_world
+enum RenderPass {
+    FEATURES_PASS = 0,
+    STREETS_PASS,
+    LABELS_PASS,
+    POIS_PASS,
+    SUBWAY_PASS,
+    INTERSECTIONS_PASS,
+    TILES_PASS, //cached tiles blitted instead of the features, streets and subway routes
+    STRIPS_PASS, //or the same drawn in parallel strips
+    BASE_LAYER_PASS, //the frame under the route overlay blitted
+    ROUTE_PASS, //path and explored segments
+    NUM_RENDER_PASSES
+};
+
+// pass times and renderer draw call counts of one frame
+struct FrameSample {
+    double pass_ms[NUM_RENDER_PASSES] = {};
+    double frame_ms = 0.0;
+    ezgl::renderer::draw_call_counts draw_calls;
+    RenderQueueStats render_queue; //of every flush during the frame, tile workers included
+};
+
+// rolling statistics of the frame times in the history
+struct FrameTimeStats {
+    double mean_ms = 0.0;
+    double p95_ms = 0.0;
+    double max_ms = 0.0;
+};
+
+struct FrameProfiler {
+    std::vector<FrameSample> frames; //ring buffer of the last frames
+    int next_frame = 0; //slot of the next frame in the ring buffer
+    int num_frames = 0; //frames recorded since the start
+    FrameSample current;
+    std::chrono::high_resolution_clock::time_point frame_start;
+    std::chrono::high_resolution_clock::time_point pass_start;
+    bool show_overlay = false;
+    std::mutex render_queue_mutex; //guards current.render_queue, render queues are flushed on several threads
+};
+
+//spatial_index.cpp
+// uniform grid over item bounding boxes, cell (row, col) is row cells[row * num_cols + col]
+struct SpatialGrid {
+    double min_x = 0.0;
+    double min_y = 0.0;
+    double cell_size = 1.0;
+    int num_cols = 0;
+    int num_rows = 0;
+    CompactAdjacency<int> cells;
+};
+
+//lod_geometry.cpp
+// simplified copies of a ProjectedPolylines, levels[i] is level i + 1 (level 0 is the original)
+struct LODPyramid {
+    std::vector<ProjectedPolylines> levels;
+};
+
+//tile_cache.cpp
+// side of a tile image in pixels
+#define TILE_PIXELS 256
+// finest zoom level, tiles of zoom z are the map width / 2^z wide
+#define MAX_TILE_ZOOM 18
+
+// a square of the world at a zoom level, zoom z splits the map width in 2^z tiles
+struct TileKey {
+    int zoom = 0;
+    int x = 0;
+    int y = 0;
+
+    bool operator==(const TileKey& other) const {
+        return zoom == other.zoom && x == other.x && y == other.y;
+    }
+};
+
+struct TileKeyHash {
+    size_t operator()(const TileKey& key) const {
+        return (size_t(key.zoom) << 58) ^ (size_t(uint32_t(key.x)) << 29) ^ size_t(uint32_t(key.y));
+    }
+};
+
+struct CachedTile {
+    cairo_surface_t* surface = nullptr;
+    std::list<TileKey>::iterator lru_position;
+};
+
+// rendered tiles, the queue of missing ones and the workers that render them,
+// everything but enabled, application and canvas is guarded by mutex
+struct TileCache {
+    bool enabled = true;
+    ezgl::application* application = nullptr;
+    ezgl::canvas* canvas = nullptr;
+
+    std::unordered_map<TileKey, CachedTile, TileKeyHash> tiles;
+    std::list<TileKey> lru; //most recently drawn first
+    size_t bytes = 0;
+
+    std::deque<TileKey> requests; //missing tiles of the last frame, nearest to the center first
+    std::unordered_set<TileKey, TileKeyHash> pending; //requested or being rendered
+    int generation = 0; //bumped when the cached tiles no longer match the map or the style
+    int style = -1;
+    double origin_x = 0.0; //bottom left of the map, corner of tile (z, 0, 0)
+    double origin_y = 0.0;
+    double map_width = 0.0;
+
+    int active_renders = 0;
+    const std::vector<std::function<void()>>* strip_jobs = nullptr; //strips of a parallel redraw, run before tiles
+    int next_strip = 0;
+    int strips_running = 0;
+    MapStyle strip_style; //style of the redraw the strips belong to
+    bool stopping = false;
+    bool refresh_queued = false;
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable work_ready;
+    std::condition_variable work_done;
+};
+
+//icon_atlas.cpp
+enum IconKind {
+    SUBWAY_ICON = 0,
+    TOILET_ICON,
+    TOILET_WHEELCHAIR_ICON,
+    LOCATION_ICON,
+    NUM_ICONS
+};
+#define NUM_ICON_ZOOM_BUCKETS 3
+
+// every icon pre-scaled once per zoom bucket, and the screen grid of the icons drawn this frame
+struct IconAtlas {
+    bool loaded = false;
+    cairo_surface_t* images[NUM_ICONS][NUM_ICON_ZOOM_BUCKETS] = {}; //nullptr if the image could not be read
+    int sizes[NUM_ICONS][NUM_ICON_ZOOM_BUCKETS] = {}; //side in pixels
+    int bucket = 0; //zoom bucket of this frame
+
+    std::vector<int> cells; //index in placed of the icon in each cell, or -1
+    std::vector<ezgl::point2d> placed; //screen centers of the icons drawn this frame
+    int cell_pixels = 1;
+    int num_cols = 0;
+    int num_rows = 0;
+    double pixels_per_world = 1.0;
+    double world_left = 0.0;
+    double world_top = 0.0;
+};
+
+// projected positions of one kind of POI icon, with a grid to find the ones on screen
+struct IconLayer {
+    IconKind kind = SUBWAY_ICON;
+    std::vector<double> x;
+    std::vector<double> y;
+    SpatialGrid grid;
+    std::vector<int> drawn; //items drawn this frame, not skipped for overlapping
+};
+
+//headless_render.cpp
+// one image of a headless render, the world rectangle has the aspect ratio of the image
+struct RenderJob {
+    std::string file_name; //a .svg file name makes an SVG file, anything else a PNG file
+    ezgl::rectangle world;
+    int width = TILE_PIXELS;
+    int height = TILE_PIXELS;
+};
+
+//road_classes.cpp
+// class of a street segment from the highway= tag of its OSM way, most important first
+enum RoadClass {
+    MOTORWAY_ROAD = 0,
+    TRUNK_ROAD,
+    PRIMARY_ROAD,
+    SECONDARY_ROAD,
+    TERTIARY_ROAD,
+    UNCLASSIFIED_ROAD,
+    RESIDENTIAL_ROAD,
+    SERVICE_ROAD,
+    OTHER_ROAD, //no highway= value above, or no OSM way
+    NUM_ROAD_CLASSES
+};
+
+//route_overlay.cpp
+// image of the frame under the route overlay and the view and style it was drawn for
+struct BaseLayer {
+    cairo_surface_t* surface = nullptr;
+    ezgl::rectangle world;
+    int width = 0;
+    int height = 0;
+    int style = -1;
+};
+
+// playback of the explored segments in search order on the animation renderer,
+// counts are in points of RouteOverlay::explored_lines
+struct SearchPlayback {
+    bool active = false;
+    guint timer = 0;
+    ezgl::application* application = nullptr;
+    int played = 0; //drawn so far
+    int frontier = 0; //start of the batch drawn last, in the frontier colour
+    int points_per_frame = 2;
+};
+
+// the found path and the segments explored to find it, as lists and as projected lines
+struct RouteOverlay {
+    std::vector<StreetSegmentIdx> route;
+    std::vector<StreetSegmentIdx> explored; //in search order
+    std::vector<ezgl::point2d> route_lines;
+    std::vector<ezgl::point2d> explored_lines;
+    BaseLayer base;
+    SearchPlayback playback;
+};
+
+//m3.cpp
 struct Node {
     std::vector<std::pair<StreetSegmentIdx, int>> out_going_edge_to_Node; //All edges connected to that node
     bool visited; //If the node is already visited for path search
@@ -100,30 +598,11 @@ struct Node {
 extern std::vector<StreetSegmentIdx> popped;
 extern std::vector<std::string> maps;
 extern std::vector<Intersection_data> intersections;
-extern std::vector<FeatureIdx> parks;
-extern std::vector<FeatureIdx> lakes;
-extern std::vector<FeatureIdx> rivers;
-extern std::vector<FeatureIdx> beaches;
-extern std::vector<FeatureIdx> islands;
-extern std::vector<FeatureIdx> buildings;
-extern std::vector<FeatureIdx> greenspaces;
-extern std::vector<FeatureIdx> golfcourses;
-extern std::vector<FeatureIdx> streams;
-extern std::vector<FeatureIdx> glaciers;
+extern CompactAdjacency<FeatureIdx> feature_buckets; //row = FeatureType, largest draw_size first
 extern std::vector<LatLon> subway_stations;
 extern std::vector<std::pair<LatLon, std::string >> toilets;
 extern std::vector<std::pair<LatLon, std::string >>  toilets_wheelchair;
-extern std::vector<std::pair<LatLon, LatLon>> subway_nodes;
-extern std::vector<std::pair<LatLon, LatLon>>  tertiary_highway_nodes;
-extern std::vector<std::pair<LatLon, LatLon>>  secondary_highway_nodes;
-extern std::vector<std::pair<LatLon, LatLon>>   primary_highway_nodes;
-extern std::vector<std::pair<LatLon, LatLon>>    quaternary_highway_nodes;
-extern std::vector<std::pair<LatLon, LatLon>>    primary_link_nodes;
-
-extern ezgl::surface* surface_subway;
-extern ezgl::surface* surface_toilet;
-extern ezgl::surface* surface_toilet_wheelchair;
-extern ezgl::surface* surface_location;
+
 
 extern double avg_lat;
 extern double max_lat;
@@ -131,39 +610,115 @@ extern double min_lat;
 extern double max_lon;
 extern double min_lon;
 
+extern bool pinkify;
+extern bool subway_show;
+extern bool parallel_render;
+extern ezgl::canvas* main_canvas;
+extern thread_local MapStyle map_style; //style of the frame, tile or strip this thread draws
+
 //m3.cpp
 extern bool find_path_pressed;
 extern std::vector<std::pair<StreetIdx, double>> segment_time;
 extern std::vector<IntersectionIdx> highlighted;
-extern std::vector<bool> segment_highlighted;
-extern std::vector<bool> explore_highlighted;
 extern std::vector<Node> Nodes;
 extern std::vector<std::pair<StreetIdx, double >> Path_street_length;
 extern std::vector<StreetSegmentIdx> make_vector_from_list(std::list<StreetSegmentIdx> list);
 extern std::vector<StreetSegmentIdx> bfsTraceBack (int destID);
 extern std::vector<std::string> turn_to;
 
+//fuzzy_search.cpp
+extern FuzzyNameIndex street_name_index;
+extern FuzzyNameIndex intersection_name_index;
+extern FuzzyNameIndex poi_name_index;
+
+//distance_kernels.cpp
+extern PointArray intersection_points;
+extern PointArray poi_points;
+
+//projected_geometry.cpp
+extern MapProjection map_projection;
+extern ProjectedPoints intersection_xy;
+extern ProjectedPoints poi_xy;
+extern ProjectedPolylines segment_xy; //from, curve points, to
+extern ProjectedPolylines feature_xy;
+extern ProjectedPolylines way_xy; //OSM way nodes
+extern FeatureMetadataTable feature_metadata;
+
+//osm_tags.cpp
+extern OSMStringPool osm_tag_strings;
+extern OSMTagTable node_tags;
+extern OSMTagTable way_tags;
+extern OSMTagTable relation_tags;
+extern std::vector<OSMTagQuery> osm_tag_queries;
+extern int osm_layer_queries[NUM_OSM_LAYERS]; //index in osm_tag_queries of each layer, set by load_osm_layers
+
+//frame_profiler.cpp
+extern FrameProfiler frame_profiler;
+
+//render_queue.cpp
+extern thread_local RenderQueue render_queue; //per thread like visible_segments
+
+//label_placement.cpp
+extern LabelEngine label_engine;
+
+//spatial_index.cpp
+extern SpatialGrid segment_grid;
+extern SpatialGrid feature_grid;
+extern SpatialGrid subway_grid;
+extern std::vector<int> subway_ways; //OSM way index of each subway_grid item
+extern thread_local std::vector<StreetSegmentIdx> visible_segments; //filled every frame
+extern thread_local CompactAdjacency<FeatureIdx> visible_features; //filled every frame, rows like feature_buckets
+extern std::vector<int> feature_draw_rank; //position of each feature in feature_buckets.values
+
+//lod_geometry.cpp
+extern LODPyramid feature_lod;
+extern LODPyramid segment_lod;
+extern thread_local int lod_level; //level drawn this frame
+
+//tile_cache.cpp
+extern TileCache tile_cache;
+
+//route_overlay.cpp
+extern RouteOverlay route_overlay;
+
+//icon_atlas.cpp
+extern IconAtlas icon_atlas;
+extern IconLayer subway_icons;
+extern IconLayer toilet_icons;
+extern IconLayer toilet_wheelchair_icons;
+
+//road_classes.cpp
+extern std::vector<RoadClass> segment_road_class;
+extern CompactAdjacency<StreetSegmentIdx> road_class_segments; //row = RoadClass, ascending ids
+extern thread_local CompactAdjacency<StreetSegmentIdx> visible_road_segments; //filled every frame the whole map is not visible, rows like road_class_segments
+
 /*******************************helper function*********************************/
 //m1.cpp
 void load_intersection_street_segments ();
 void load_street_intersections ();
+void find_common_intersections(StreetIdx street1, StreetIdx street2, std::vector<IntersectionIdx>& result);
+IndexSpan<StreetSegmentIdx> street_segments_of_intersection(IntersectionIdx intersection_id);
+IndexSpan<IntersectionIdx> intersections_of_street(StreetIdx street_id);
 void load_streetIds_from_partialStreetName ();
 void load_street_segments();
+void load_segment_geometry();
+double compute_street_segment_length(StreetSegmentIdx street_segment_id);
+double bearing_between(LatLon from, LatLon to);
 void load_intersection_street_id();
-//Two helper functions for findAngleBetweenStreetSegments
-double CosineLaw(double a, double b, double c);
-// Helper Functions for findFeatureArea
-double x_featureCoordinate (LatLon featurePoint, double lat_avg);
-double y_featureCoordinate (LatLon featurePoint);
-double computeFeatureArea (std:: vector<double> x_coord, std:: vector <double> y_coord, int numCoords);
+//Helper function for findAngleBetweenStreetSegments and find_turn_to
+double signed_turn_angle(StreetSegmentIdx src_street_segment_id, StreetSegmentIdx dst_street_segment_id);
 //OSM helper Functions - Build OSM Data Base
 void build_OSM_Database();
 void buildNodeData();
 void buildWayData();
+void buildRelationData();
 void load_Way_LatLon_of_Nodes();
 void load_Way_WayLength();
+void build_osmid_index(OSMIdIndex& index, const std::vector<OSMID>& ids);
+int find_osmid_index(const OSMIdIndex& index, OSMID id);
 const OSMNode* getNodeById(const OSMID& nodeId);
 const OSMWay* getWayById(const OSMID& wayId);
+const OSMRelation* getRelationById(const OSMID& relationId);
 const OSMNode* matchingNodesForOSMID (OSMID osm_id);
 
 //m2_pro
@@ -173,24 +728,12 @@ void set_map_address(std::string address);
 bool get_input_status();
 bool set_input_status(int num);
 
-void initial_parks();
-void initial_lakes();
-void initial_rivers();
-void initial_beaches();
-void initial_islands();
-void initial_buildings();
-void initial_greenspaces();
-void initial_golfcourses();
-void initial_streams();
-void initial_glaciers();
+void load_feature_buckets();
 
 void load_max_min_lat_lon();
-void init_subway_route();
-void load_subway_png();
-void load_toilet_png();
-void load_toilet_wheelchair_png();
-void load_location_png();
 
+void load_osm_layers();
+const std::vector<int>& osm_layer_matches(OSMLayer layer);
 void SUBWAY_OSM_Database();
 void toilet_OSM_Database();
 void toilets_wheelchair_OSM_Database();
@@ -201,7 +744,9 @@ float y_from_lat(float lat);
 float lon_from_x(float x);
 float lat_from_y(float y);
 
-void draw_features( std::vector<FeatureIdx> FeatureName, ezgl:: renderer *g);
+void draw_features(IndexSpan<FeatureIdx> FeatureName, ezgl:: renderer *g);
+void add_segment_lines(StreetSegmentIdx i, std::vector<ezgl::point2d>& lines);
+void draw_segment_polyline(StreetSegmentIdx i, ezgl::renderer* g);
 void draw_parks(ezgl:: renderer *g);
 void draw_lakes(ezgl:: renderer *g);
 void draw_rivers(ezgl:: renderer *g);
@@ -215,12 +760,22 @@ void draw_streams(ezgl:: renderer *g);
 void draw_intersections (ezgl:: renderer *g);
 void draw_subway_station(ezgl:: renderer *g);
 void draw_toilet (ezgl::renderer* g);
-void draw_toilet_label (ezgl::renderer* g);
+void add_toilet_labels ();
 void draw_toilets_wheelchair (ezgl::renderer* g);
-void draw_toilets_wheelchair_label (ezgl::renderer* g);
+void add_toilets_wheelchair_labels ();
 void draw_scale(ezgl::renderer *g, double map_scale);
 void draw_street_segments(ezgl::renderer* g, double scale);
+void add_street_labels(ezgl::renderer* g, double scale);
 void draw_subway_routes(ezgl::renderer*);
+void draw_map_background(ezgl::renderer* g);
+void draw_map_features(ezgl::renderer* g, double map_scale);
+void draw_map_base(ezgl::renderer* g, double map_scale);
+void draw_map_tile(ezgl::renderer* g);
+void draw_map_overlay(ezgl::renderer* g, double map_scale);
+void draw_map_frame(ezgl::renderer* g);
+MapStyle current_map_style();
+int map_style_key(const MapStyle& style);
+MapStyle map_style_from_key(int key);
 
 void initial_intersections();
 bool street_contain_special_char(std::string);
@@ -236,14 +791,13 @@ gboolean pinkify_switch (GtkSwitch* /*pinkify_switch*/, gboolean switch_state, e
 void initial_setup_pinkify_switch_with_text (ezgl::application* application, bool /*new window*/);
 void draw_map_intersections_xy_fixed_world();
 void toogle_pink(GtkWidget* /*widget*/, ezgl::application* application);
-void draw_street_name (ezgl::renderer* g, ezgl::point2d start, ezgl::point2d end, int index, int size);
 gboolean show_subways (GtkSwitch* /*subways_switch*/, gboolean switch_state, ezgl::application* application);
+void toggle_parallel_render(GtkWidget* /*widget*/, ezgl::application* application);
 
 //m3.cpp
 void load_segment_time();
 void clear_highlight(GtkWidget* /*widget*/, ezgl::application* application);
 void find_path (GtkWidget* /*widget*/, ezgl::application* application);
-void initial_segment_highlighted();
 void help_information(GtkWidget* /*widget*/, ezgl::application* application);
 void init_nodes();
 void find_direction(std::vector<StreetSegmentIdx> path);
@@ -258,4 +812,124 @@ void display_road_length();
 int roundToNearestHundred(double num);
 void find_total_time(std::vector<StreetSegmentIdx> path);
 
-
+//fuzzy_search.cpp
+std::string normalize_name(std::string name);
+void build_fuzzy_index(FuzzyNameIndex& index, const std::vector<std::string>& raw_names);
+std::vector<int> find_prefix_matches(const FuzzyNameIndex& index, const std::string& prefix);
+std::vector<SearchResult> fuzzySearch(std::string query, int kinds, int max_results);
+std::vector<StreetIdx> find_street_ids_with_typos(std::string street_prefix);
+void load_fuzzy_search_index();
+void clear_fuzzy_search_index();
+void benchmark_fuzzy_search(int num_queries);
+
+//distance_kernels.cpp
+void build_point_array(const std::vector<LatLon>& points, PointArray& array);
+double point_distance(const PointArray& points, int a, int b);
+void distances_from_point(LatLon from, const PointArray& points, int first, int count, double* out);
+int closest_point(LatLon from, const PointArray& points);
+double polyline_length(const PointArray& points);
+void load_point_arrays();
+void clear_point_arrays();
+void benchmark_distance_kernels(int repeats);
+
+//projected_geometry.cpp
+void load_map_projection();
+void load_projected_geometry();
+void load_feature_metadata();
+void clear_projected_geometry();
+void get_projected_row(const ProjectedPolylines& polylines, int row, std::vector<ezgl::point2d>& points);
+
+//osm_tags.cpp
+int intern_osm_string(const std::string& str);
+int find_osm_string(const std::string& str);
+const std::string& osm_string(int id);
+void load_osm_tags();
+void clear_osm_tags();
+int find_osm_tag(const OSMTagTable& table, int entity, int key_id);
+bool has_osm_tag(const OSMTagTable& table, int entity, int key_id, int value_id);
+int register_osm_tag_query(OSMEntityKind kind, const std::string& key, const std::string& value);
+void run_osm_tag_queries();
+
+//frame_profiler.cpp
+void begin_frame(ezgl::renderer* g);
+void begin_render_pass(RenderPass pass);
+void end_render_pass(RenderPass pass);
+void end_frame(ezgl::renderer* g);
+FrameTimeStats frame_time_stats();
+void draw_profiler_overlay(ezgl::renderer* g);
+bool dump_profiler_csv(const std::string& path);
+void toggle_profiler_overlay(GtkWidget* /*widget*/, ezgl::application* application);
+void dump_profiler_csv_button(GtkWidget* /*widget*/, ezgl::application* application);
+void add_render_queue_stats(const RenderQueueStats& stats);
+
+//label_placement.cpp
+const ezgl::renderer::text_extents& label_text_extents(ezgl::renderer* g, const std::string& text, int font_size);
+void begin_labels(ezgl::renderer* g);
+void add_label_candidate(const std::string& text, ezgl::point2d position, double angle, int font_size,
+                         ezgl::color color, double priority);
+void place_and_draw_labels(ezgl::renderer* g);
+void load_label_engine();
+void clear_label_engine();
+
+//render_queue.cpp
+void clear_render_queue();
+void queue_style(int layer, ezgl::color color, int line_width);
+void queue_lines(const std::vector<ezgl::point2d>& lines);
+void queue_polygon(const std::vector<ezgl::point2d>& polygon);
+void queue_rectangle(ezgl::point2d corner, double width, double height);
+void flush_render_queue(ezgl::renderer* g);
+
+//spatial_index.cpp
+void build_spatial_grid(SpatialGrid& grid, const std::vector<double>& min_x, const std::vector<double>& max_x,
+                        const std::vector<double>& min_y, const std::vector<double>& max_y);
+void query_spatial_grid(const SpatialGrid& grid, const ezgl::rectangle& area, std::vector<int>& result);
+void load_spatial_index();
+void clear_spatial_index();
+void load_visible_items(const ezgl::rectangle& visible_world);
+
+//lod_geometry.cpp
+void simplify_polyline(const double* x, const double* y, int count, double tolerance, std::vector<int>& keep);
+void load_lod_geometry();
+void clear_lod_geometry();
+void select_lod_level(ezgl::renderer* g);
+const ProjectedPolylines& lod_polylines(const LODPyramid& pyramid, const ProjectedPolylines& base);
+
+//tile_cache.cpp
+void start_tile_cache(ezgl::application* application);
+void stop_tile_cache();
+void clear_tile_cache();
+void invalidate_tile_cache();
+bool draw_cached_tiles(ezgl::renderer* g);
+void toggle_tile_cache(GtkWidget* /*widget*/, ezgl::application* application);
+int num_render_threads();
+void run_on_tile_workers(const std::vector<std::function<void()>>& jobs);
+
+//route_overlay.cpp
+void set_route_overlay(const std::vector<StreetSegmentIdx>& route, const std::vector<StreetSegmentIdx>& explored);
+void clear_route_overlay();
+void invalidate_base_layer();
+void draw_base_layer(ezgl::renderer* g);
+void draw_route_overlay(ezgl::renderer* g);
+void play_search_exploration(GtkWidget* /*widget*/, ezgl::application* application);
+
+//icon_atlas.cpp
+void load_icon_atlas();
+void load_icon_layers();
+void clear_icon_layers();
+void begin_icons(ezgl::renderer* g);
+void draw_icon(ezgl::renderer* g, IconKind kind, ezgl::point2d position);
+void draw_icon_layer(ezgl::renderer* g, IconLayer& layer);
+
+//headless_render.cpp
+bool load_render_boxes(const std::string& path, std::vector<RenderJob>& jobs);
+bool add_tile_pyramid_jobs(int max_zoom, const std::string& out_dir, const std::string& extension, std::vector<RenderJob>& jobs);
+void draw_headless_image(ezgl::renderer* g);
+bool render_headless(const std::vector<RenderJob>& jobs, int num_threads);
+bool render_box_file(const std::string& path, int num_threads);
+bool render_tile_pyramid(int max_zoom, const std::string& out_dir, const std::string& extension, int num_threads);
+
+//road_classes.cpp
+void load_road_classes();
+void clear_road_classes();
+void load_visible_road_segments();
+void add_road_class_lines(RoadClass road_class, std::vector<ezgl::point2d>& lines);
@@ -0,0 +1,154 @@
+//
+// Headless rendering: map images written straight to PNG or SVG files by worker threads, with no
+// window or GTK main loop, from a list of bounding boxes or a pyramid of tiles. Also a benchmark
+//
+
+#include "global.h"
+#include <atomic>
+#include <filesystem>
+#include <fstream>
+
+// Initialize value here
+// the overlay shares the label engine, so one image draws it at a time
+static std::mutex overlay_mutex;
+
+// one line per image: file_name min_lon min_lat max_lon max_lat width height, # starts a comment
+bool load_render_boxes(const std::string& path, std::vector<RenderJob>& jobs) {
+    std::ifstream boxes(path);
+    if (!boxes) {
+        std::cerr << "Could not open render boxes '" << path << "'\n";
+        return false;
+    }
+
+    std::string line;
+    int line_number = 0;
+    while (std::getline(boxes, line)) {
+        line_number++;
+        std::istringstream fields(line);
+        RenderJob job;
+        double min_lon, min_lat, max_lon, max_lat;
+        if (!(fields >> job.file_name) || job.file_name[0] == '#') {
+            continue;
+        }
+        if (!(fields >> min_lon >> min_lat >> max_lon >> max_lat >> job.width >> job.height) ||
+            job.width <= 0 || job.height <= 0 || min_lon >= max_lon || min_lat >= max_lat) {
+            std::cerr << path << ":" << line_number << ": expected file_name min_lon min_lat max_lon max_lat width height\n";
+            return false;
+        }
+        job.world = ezgl::rectangle({x_from_lon(min_lon), y_from_lat(min_lat)}, {x_from_lon(max_lon), y_from_lat(max_lat)});
+        jobs.push_back(job);
+    }
+    return true;
+}
+
+// every tile of zoom levels 0 to max_zoom over the map, in the layout of the tile cache,
+// written to out_dir/zoom/x_y.extension with y counted up from the bottom of the map,
+// returns false if a zoom directory could not be created
+bool add_tile_pyramid_jobs(int max_zoom, const std::string& out_dir, const std::string& extension, std::vector<RenderJob>& jobs) {
+    double origin_x = x_from_lon(min_lon);
+    double origin_y = y_from_lat(min_lat);
+    double map_width = x_from_lon(max_lon) - origin_x;
+    double map_height = y_from_lat(max_lat) - origin_y;
+
+    for (int zoom = 0; zoom <= max_zoom; ++zoom) {
+        double size = map_width / (1 << zoom);
+        int num_y = std::max(1, int(std::ceil(map_height / size)));
+        std::string zoom_dir = out_dir + "/" + std::to_string(zoom);
+        std::error_code error;
+        std::filesystem::create_directories(zoom_dir, error);
+        if (error) {
+            std::cerr << "Could not create '" << zoom_dir << "': " << error.message() << "\n";
+            return false;
+        }
+
+        for (int y = 0; y < num_y; ++y) {
+            for (int x = 0; x < (1 << zoom); ++x) {
+                RenderJob job;
+                job.file_name = out_dir + "/" + std::to_string(zoom) + "/" + std::to_string(x) + "_" +
+                                std::to_string(y) + "." + extension;
+                job.world = ezgl::rectangle({origin_x + x * size, origin_y + y * size}, size, size);
+                jobs.push_back(job);
+            }
+        }
+    }
+    return true;
+}
+
+// the map as draw_main_canvas_xy_fixed_world draws it, without the frame profiler and the tile cache:
+// the base is thread safe like a tile, the overlay is drawn by one image at a time
+void draw_headless_image(ezgl::renderer* g) {
+    draw_map_tile(g);
+
+    std::lock_guard<std::mutex> lock(overlay_mutex);
+    draw_map_overlay(g, distance_scaling_fct(g));
+}
+
+// render the jobs on num_threads threads, then print the time of every image and a summary,
+// returns false if some file could not be written
+bool render_headless(const std::vector<RenderJob>& jobs, int num_threads) {
+    std::vector<double> image_ms(jobs.size(), 0.0);
+    std::vector<ezgl::renderer::draw_call_counts> counts(jobs.size());
+    std::vector<char> written(jobs.size(), false);
+    std::atomic<int> next_job(0);
+    MapStyle style = current_map_style();
+
+    auto start = std::chrono::high_resolution_clock::now();
+    std::vector<std::thread> workers;
+    for (int i = 0; i < std::max(1, num_threads); ++i) {
+        workers.emplace_back([&]() {
+            map_style = style;
+            for (int job = next_job++; job < jobs.size(); job = next_job++) {
+                auto image_start = std::chrono::high_resolution_clock::now();
+                written[job] = ezgl::canvas::render_to_file(jobs[job].file_name.c_str(), jobs[job].world, jobs[job].width,
+                                                            jobs[job].height, draw_headless_image, ezgl::WHITE, &counts[job]);
+                std::chrono::duration<double, std::milli> elapsed = std::chrono::high_resolution_clock::now() - image_start;
+                image_ms[job] = elapsed.count();
+            }
+        });
+    }
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+    std::chrono::duration<double, std::milli> total = std::chrono::high_resolution_clock::now() - start;
+
+    bool all_written = true;
+    std::cout << "file,image_ms,lines_drawn,polys_drawn,texts_drawn,strokes\n";
+    for (int job = 0; job < jobs.size(); ++job) {
+        if (!written[job]) {
+            std::cerr << "Failed to write '" << jobs[job].file_name << "'\n";
+            all_written = false;
+        }
+        std::cout << jobs[job].file_name << "," << image_ms[job] << "," << counts[job].lines_drawn << ","
+                  << counts[job].polys_drawn << "," << counts[job].texts_drawn << "," << counts[job].strokes << "\n";
+    }
+
+    if (!jobs.empty()) {
+        std::vector<double> sorted_ms = image_ms;
+        std::sort(sorted_ms.begin(), sorted_ms.end());
+        double mean_ms = 0.0;
+        for (double ms : sorted_ms) {
+            mean_ms += ms;
+        }
+        mean_ms /= sorted_ms.size();
+        std::cout << jobs.size() << " images on " << std::max(1, num_threads) << " threads in " << total.count()
+                  << " ms, mean " << mean_ms << " ms, p95 " << sorted_ms[(sorted_ms.size() - 1) * 95 / 100]
+                  << " ms, max " << sorted_ms.back() << " ms\n";
+    }
+    return all_written;
+}
+
+// --render-boxes: an image per line of the file
+bool render_box_file(const std::string& path, int num_threads) {
+    std::vector<RenderJob> jobs;
+    return load_render_boxes(path, jobs) && render_headless(jobs, num_threads);
+}
+
+// --render-tiles: the tile pyramid from zoom 0 to max_zoom, extension png or svg
+bool render_tile_pyramid(int max_zoom, const std::string& out_dir, const std::string& extension, int num_threads) {
+    if (max_zoom < 0 || max_zoom > MAX_TILE_ZOOM || (extension != "png" && extension != "svg")) {
+        std::cerr << "Expected a zoom level from 0 to " << MAX_TILE_ZOOM << " and png or svg\n";
+        return false;
+    }
+    std::vector<RenderJob> jobs;
+    return add_tile_pyramid_jobs(max_zoom, out_dir, extension, jobs) && render_headless(jobs, num_threads);
+}
@@ -0,0 +1,174 @@
+//
+// Icon atlas: the POI icons read once per process and pre-scaled to a few zoom buckets, so drawing an
+// icon blits it at its own size. Icons off screen are skipped with a grid per layer, and icons that
+// would overlap one already drawn this frame are skipped with a screen space grid
+//
+
+#include "global.h"
+
+// Initialize value here
+IconAtlas icon_atlas;
+IconLayer subway_icons;
+IconLayer toilet_icons;
+IconLayer toilet_wheelchair_icons;
+
+static const char* icon_files[NUM_ICONS] = {
+    "libstreetmap/resources/subway_station.png",
+    "libstreetmap/resources/toilet.png",
+    "libstreetmap/resources/toilet_wheelchair.png",
+    "libstreetmap/resources/location.png"
+};
+// side in pixels of every icon at the closest zoom bucket, the sizes they were drawn at before the atlas
+static const int icon_pixels[NUM_ICONS] = {33, 31, 38, 33};
+// icons shrink when zoomed out, bucket b is used from bucket_min_scale[b] (distance_scaling_fct)
+static const double bucket_scales[NUM_ICON_ZOOM_BUCKETS] = {0.5, 0.75, 1.0};
+static const double bucket_min_scale[NUM_ICON_ZOOM_BUCKETS] = {0.0, 1.0, 3.0};
+
+// the image resampled once to size x size pixels, nullptr if the image could not be read
+static cairo_surface_t* prescale_icon(cairo_surface_t* image, int size) {
+    if (cairo_surface_status(image) != CAIRO_STATUS_SUCCESS) {
+        return nullptr;
+    }
+    cairo_surface_t* icon = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, size, size);
+    cairo_t* context = cairo_create(icon);
+    cairo_scale(context, double(size) / cairo_image_surface_get_width(image),
+                double(size) / cairo_image_surface_get_height(image));
+    cairo_set_source_surface(context, image, 0, 0);
+    cairo_pattern_set_filter(cairo_get_source(context), CAIRO_FILTER_BEST);
+    cairo_paint(context);
+    cairo_destroy(context);
+    return icon;
+}
+
+// called from loadMap, the images are read and scaled by the first map only, they are kept for the
+// other maps until the process ends
+void load_icon_atlas() {
+    if (icon_atlas.loaded) {
+        return;
+    }
+    for (int kind = 0; kind < NUM_ICONS; ++kind) {
+        cairo_surface_t* image = ezgl::renderer::load_png(icon_files[kind]);
+        for (int bucket = 0; bucket < NUM_ICON_ZOOM_BUCKETS; ++bucket) {
+            icon_atlas.sizes[kind][bucket] = std::max(1, int(std::lround(icon_pixels[kind] * bucket_scales[bucket])));
+            icon_atlas.images[kind][bucket] = prescale_icon(image, icon_atlas.sizes[kind][bucket]);
+        }
+        cairo_surface_destroy(image);
+    }
+    icon_atlas.loaded = true;
+}
+
+static void load_icon_layer(IconLayer& layer, IconKind kind, const std::vector<LatLon>& positions) {
+    layer.kind = kind;
+    layer.x.resize(positions.size());
+    layer.y.resize(positions.size());
+    for (int i = 0; i < positions.size(); ++i) {
+        layer.x[i] = x_from_lon(positions[i].longitude());
+        layer.y[i] = y_from_lat(positions[i].latitude());
+    }
+    build_spatial_grid(layer.grid, layer.x, layer.x, layer.y, layer.y);
+}
+
+// called from loadMap after load_spatial_index, the projected position of every POI icon
+void load_icon_layers() {
+    std::vector<LatLon> positions;
+    load_icon_layer(subway_icons, SUBWAY_ICON, subway_stations);
+
+    for (const auto& toilet : toilets) {
+        positions.push_back(toilet.first);
+    }
+    load_icon_layer(toilet_icons, TOILET_ICON, positions);
+
+    positions.clear();
+    for (const auto& toilet : toilets_wheelchair) {
+        positions.push_back(toilet.first);
+    }
+    load_icon_layer(toilet_wheelchair_icons, TOILET_WHEELCHAIR_ICON, positions);
+}
+
+void clear_icon_layers() {
+    subway_icons = IconLayer();
+    toilet_icons = IconLayer();
+    toilet_wheelchair_icons = IconLayer();
+}
+
+// pick the zoom bucket and empty the screen grid, called once per frame before the icon layers
+void begin_icons(ezgl::renderer* g) {
+    double map_scale = distance_scaling_fct(g);
+    icon_atlas.bucket = 0;
+    while (icon_atlas.bucket + 1 < NUM_ICON_ZOOM_BUCKETS && map_scale > bucket_min_scale[icon_atlas.bucket + 1]) {
+        icon_atlas.bucket++;
+    }
+
+    // the grid cells are as big as the biggest icon, so an icon can only overlap icons of the 3x3 cells around it,
+    // with a border of one cell for the icons centered just off screen
+    icon_atlas.cell_pixels = 1;
+    for (int kind = 0; kind < NUM_ICONS; ++kind) {
+        icon_atlas.cell_pixels = std::max(icon_atlas.cell_pixels, icon_atlas.sizes[kind][icon_atlas.bucket]);
+    }
+    ezgl::rectangle visible_world = g->get_visible_world();
+    ezgl::rectangle visible_screen = g->get_visible_screen();
+    icon_atlas.pixels_per_world = visible_screen.width() / visible_world.width();
+    icon_atlas.world_left = visible_world.left();
+    icon_atlas.world_top = visible_world.top();
+    icon_atlas.num_cols = int(visible_screen.width()) / icon_atlas.cell_pixels + 3;
+    icon_atlas.num_rows = int(visible_screen.height()) / icon_atlas.cell_pixels + 3;
+    icon_atlas.cells.assign(icon_atlas.num_cols * icon_atlas.num_rows, -1);
+    icon_atlas.placed.clear();
+}
+
+// true if an icon at the screen point overlaps no icon drawn this frame, it is then marked in the grid
+static bool claim_icon_space(double screen_x, double screen_y) {
+    int col = std::floor(screen_x / icon_atlas.cell_pixels) + 1;
+    int row = std::floor(screen_y / icon_atlas.cell_pixels) + 1;
+    if (col < 0 || row < 0 || col >= icon_atlas.num_cols || row >= icon_atlas.num_rows) {
+        return false;
+    }
+
+    for (int r = std::max(0, row - 1); r <= std::min(icon_atlas.num_rows - 1, row + 1); ++r) {
+        for (int c = std::max(0, col - 1); c <= std::min(icon_atlas.num_cols - 1, col + 1); ++c) {
+            int other = icon_atlas.cells[r * icon_atlas.num_cols + c];
+            if (other != -1 && std::abs(icon_atlas.placed[other].x - screen_x) < icon_atlas.cell_pixels &&
+                std::abs(icon_atlas.placed[other].y - screen_y) < icon_atlas.cell_pixels) {
+                return false;
+            }
+        }
+    }
+
+    icon_atlas.cells[row * icon_atlas.num_cols + col] = icon_atlas.placed.size();
+    icon_atlas.placed.push_back({screen_x, screen_y});
+    return true;
+}
+
+// one icon centered on a world point at the size of the zoom bucket, drawn even if it overlaps others
+void draw_icon(ezgl::renderer* g, IconKind kind, ezgl::point2d position) {
+    cairo_surface_t* image = icon_atlas.images[kind][icon_atlas.bucket];
+    if (image != nullptr) {
+        g->draw_surface(image, position);
+    }
+}
+
+// the icons of the layer on screen, in layer order, skipping the ones overlapping an icon already drawn,
+// the ones drawn are kept in layer.drawn for their labels
+void draw_icon_layer(ezgl::renderer* g, IconLayer& layer) {
+    layer.drawn.clear();
+    if (icon_atlas.images[layer.kind][icon_atlas.bucket] == nullptr) {
+        return;
+    }
+
+    // icons whose center is just off screen still show their edge
+    static thread_local std::vector<int> visible;
+    ezgl::rectangle visible_world = g->get_visible_world();
+    double margin = icon_atlas.sizes[layer.kind][icon_atlas.bucket] / icon_atlas.pixels_per_world;
+    ezgl::rectangle area({visible_world.left() - margin, visible_world.bottom() - margin},
+                         {visible_world.right() + margin, visible_world.top() + margin});
+    query_spatial_grid(layer.grid, area, visible);
+
+    for (int i : visible) {
+        double screen_x = (layer.x[i] - icon_atlas.world_left) * icon_atlas.pixels_per_world;
+        double screen_y = (icon_atlas.world_top - layer.y[i]) * icon_atlas.pixels_per_world;
+        if (claim_icon_space(screen_x, screen_y)) {
+            draw_icon(g, layer.kind, {layer.x[i], layer.y[i]});
+            layer.drawn.push_back(i);
+        }
+    }
+}
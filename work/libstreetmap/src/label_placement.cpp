@@ -0,0 +1,167 @@
+//
+// Label placement: the labels of a frame are collected as candidates with a priority, then placed
+// greedily in priority order against a screen space collision grid, only the placed ones are drawn.
+// Text extents are measured once per (text, font size) and cached
+//
+
+#include "global.h"
+
+// Initialize value here
+LabelEngine label_engine;
+
+// side of a collision grid cell in pixels
+#define LABEL_CELL_PIXELS 64
+// empty space kept around every placed label, in pixels
+#define LABEL_PADDING 4
+// the text extents cache is emptied past this many entries
+#define MAX_CACHED_TEXTS 100000
+
+// extents of the text at the font size, measured with the renderer the first time it is seen
+const ezgl::renderer::text_extents& label_text_extents(ezgl::renderer* g, const std::string& text, int font_size) {
+    LabelTextKey key = {text, font_size};
+    auto cached = label_engine.text_cache.find(key);
+    if (cached != label_engine.text_cache.end()) {
+        return cached->second;
+    }
+
+    if (label_engine.text_cache.size() >= MAX_CACHED_TEXTS) {
+        label_engine.text_cache.clear();
+    }
+    g->set_font_size(font_size);
+    label_engine.texts_measured++;
+    return label_engine.text_cache.emplace(key, g->measure_text(text)).first->second;
+}
+
+// start the labels of a frame: empty candidates and an empty grid over the visible screen
+void begin_labels(ezgl::renderer* g) {
+    ezgl::rectangle visible_world = g->get_visible_world();
+    ezgl::rectangle visible_screen = g->get_visible_screen();
+
+    label_engine.candidates.clear();
+    label_engine.placed.clear();
+    label_engine.pixels_per_world = visible_screen.width() / visible_world.width();
+    label_engine.world_left = visible_world.left();
+    label_engine.world_top = visible_world.top();
+    label_engine.screen_width = visible_screen.width();
+    label_engine.screen_height = visible_screen.height();
+
+    label_engine.num_cols = std::max(1, int(std::ceil(visible_screen.width() / LABEL_CELL_PIXELS)));
+    label_engine.num_rows = std::max(1, int(std::ceil(visible_screen.height() / LABEL_CELL_PIXELS)));
+    label_engine.cells.resize(label_engine.num_cols * label_engine.num_rows);
+    for (std::vector<int>& cell : label_engine.cells) {
+        cell.clear();
+    }
+}
+
+// a label centered at a world point, rotated by angle degrees, higher priorities are placed first
+void add_label_candidate(const std::string& text, ezgl::point2d position, double angle, int font_size,
+                         ezgl::color color, double priority) {
+    LabelCandidate candidate;
+    candidate.text = &text;
+    candidate.position = position;
+    candidate.angle = angle;
+    candidate.font_size = font_size;
+    candidate.color = color;
+    candidate.priority = priority;
+    label_engine.candidates.push_back(candidate);
+}
+
+// true if the screen box overlaps no placed label, the box is then marked in the grid
+static bool try_place_box(const LabelBox& box) {
+    if (box.right < 0 || box.left > label_engine.screen_width || box.bottom < 0 || box.top > label_engine.screen_height) {
+        return false;
+    }
+
+    int first_col = std::max(0, int(box.left / LABEL_CELL_PIXELS));
+    int last_col = std::min(label_engine.num_cols - 1, int(box.right / LABEL_CELL_PIXELS));
+    int first_row = std::max(0, int(box.top / LABEL_CELL_PIXELS));
+    int last_row = std::min(label_engine.num_rows - 1, int(box.bottom / LABEL_CELL_PIXELS));
+
+    for (int row = first_row; row <= last_row; ++row) {
+        for (int col = first_col; col <= last_col; ++col) {
+            for (int other : label_engine.cells[row * label_engine.num_cols + col]) {
+                const LabelBox& placed = label_engine.placed[other];
+                if (box.left < placed.right && placed.left < box.right && box.top < placed.bottom && placed.top < box.bottom) {
+                    return false;
+                }
+            }
+        }
+    }
+
+    int index = label_engine.placed.size();
+    label_engine.placed.push_back(box);
+    for (int row = first_row; row <= last_row; ++row) {
+        for (int col = first_col; col <= last_col; ++col) {
+            label_engine.cells[row * label_engine.num_cols + col].push_back(index);
+        }
+    }
+    return true;
+}
+
+// place the candidates in priority order and draw the ones that fit
+void place_and_draw_labels(ezgl::renderer* g) {
+    std::vector<LabelCandidate>& candidates = label_engine.candidates;
+    std::stable_sort(candidates.begin(), candidates.end(), [](const LabelCandidate& lhs, const LabelCandidate& rhs) {
+        return lhs.priority > rhs.priority;
+    });
+
+    int font_size = -1;
+    double angle = 0.0;
+    ezgl::color color = ezgl::BLACK;
+    g->set_color(color);
+    g->set_text_rotation(angle);
+
+    for (const LabelCandidate& candidate : candidates) {
+        // measuring a text for the first time sets the font size of the renderer behind font_size
+        size_t texts_measured = label_engine.texts_measured;
+        const ezgl::renderer::text_extents& extents = label_text_extents(g, *candidate.text, candidate.font_size);
+        if (label_engine.texts_measured != texts_measured) {
+            font_size = candidate.font_size;
+        }
+
+        // screen box of the rotated text around its center, y grows downwards on screen
+        double radians = candidate.angle * kDegreeToRadian;
+        double half_width = (std::abs(extents.width * std::cos(radians)) + std::abs(extents.height * std::sin(radians))) / 2.0;
+        double half_height = (std::abs(extents.width * std::sin(radians)) + std::abs(extents.height * std::cos(radians))) / 2.0;
+        double x = (candidate.position.x - label_engine.world_left) * label_engine.pixels_per_world;
+        double y = (label_engine.world_top - candidate.position.y) * label_engine.pixels_per_world;
+
+        LabelBox box;
+        box.left = x - half_width - LABEL_PADDING;
+        box.right = x + half_width + LABEL_PADDING;
+        box.top = y - half_height - LABEL_PADDING;
+        box.bottom = y + half_height + LABEL_PADDING;
+        if (!try_place_box(box)) {
+            continue;
+        }
+
+        // only change the renderer state when the label needs it
+        if (candidate.font_size != font_size) {
+            font_size = candidate.font_size;
+            g->set_font_size(font_size);
+        }
+        if (!(candidate.color == color)) {
+            color = candidate.color;
+            g->set_color(color);
+        }
+        if (candidate.angle != angle) {
+            angle = candidate.angle;
+            g->set_text_rotation(angle);
+        }
+        g->draw_text(candidate.position, *candidate.text, extents);
+    }
+
+    g->set_text_rotation(0);
+}
+
+// called from loadMap, street names are read once instead of for every label of every frame
+void load_label_engine() {
+    label_engine.street_names.resize(getNumStreets());
+    for (int i = 0; i < getNumStreets(); ++i) {
+        label_engine.street_names[i] = getStreetName(i);
+    }
+}
+
+void clear_label_engine() {
+    label_engine = LabelEngine();
+}
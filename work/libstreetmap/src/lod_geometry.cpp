@@ -0,0 +1,155 @@
+//
+// Level of detail geometry: the projected feature and segment polylines simplified
+// with Douglas-Peucker at a few tolerances, the level is picked per frame from the zoom
+//
+
+#include "global.h"
+
+// Initialize value here
+LODPyramid feature_lod;
+LODPyramid segment_lod;
+thread_local int lod_level = 0; //per thread like visible_segments
+
+// simplification tolerances of levels 1 and up, in world units (meters), level 0 is the full geometry
+static const double lod_tolerances[] = {2.0, 8.0, 32.0, 128.0};
+#define NUM_LOD_LEVELS 5
+// the level is chosen so the simplification error stays under this fraction of a pixel
+#define LOD_PIXEL_ERROR 0.5
+
+// squared distance from point p to the segment a-b
+static double squared_distance_to_segment(double px, double py, double ax, double ay, double bx, double by) {
+    double dx = bx - ax;
+    double dy = by - ay;
+    double length_squared = dx * dx + dy * dy;
+    double t = 0.0;
+    if (length_squared > 0.0) {
+        t = std::max(0.0, std::min(1.0, ((px - ax) * dx + (py - ay) * dy) / length_squared));
+    }
+    double ex = ax + t * dx - px;
+    double ey = ay + t * dy - py;
+    return ex * ex + ey * ey;
+}
+
+// Douglas-Peucker: indices (0 .. count - 1, in order) of the points kept so no dropped point
+// is further than tolerance from the simplified line, the two ends are always kept
+void simplify_polyline(const double* x, const double* y, int count, double tolerance, std::vector<int>& keep) {
+    keep.clear();
+    if (count <= 2) {
+        for (int i = 0; i < count; ++i) {
+            keep.push_back(i);
+        }
+        return;
+    }
+
+    std::vector<char> kept(count, false);
+    kept[0] = kept[count - 1] = true;
+    double tolerance_squared = tolerance * tolerance;
+
+    // ranges still to split, an explicit stack so long rings can not overflow the call stack
+    std::vector<std::pair<int, int>> ranges;
+    ranges.push_back(std::make_pair(0, count - 1));
+    while (!ranges.empty()) {
+        int first = ranges.back().first;
+        int last = ranges.back().second;
+        ranges.pop_back();
+
+        int farthest = -1;
+        double farthest_distance = tolerance_squared;
+        for (int i = first + 1; i < last; ++i) {
+            double distance = squared_distance_to_segment(x[i], y[i], x[first], y[first], x[last], y[last]);
+            if (distance > farthest_distance) {
+                farthest_distance = distance;
+                farthest = i;
+            }
+        }
+        if (farthest != -1) {
+            kept[farthest] = true;
+            ranges.push_back(std::make_pair(first, farthest));
+            ranges.push_back(std::make_pair(farthest, last));
+        }
+    }
+
+    for (int i = 0; i < count; ++i) {
+        if (kept[i]) {
+            keep.push_back(i);
+        }
+    }
+}
+
+// simplify every row of base at every tolerance, closed rings that collapse (fewer than 4 points)
+// or fit inside the tolerance become empty rows so they are not drawn at that level
+static void build_lod_pyramid(const ProjectedPolylines& base, LODPyramid& pyramid) {
+    int num_rows = base.offsets.size() - 1;
+    pyramid.levels.assign(NUM_LOD_LEVELS - 1, ProjectedPolylines());
+    std::vector<std::vector<int>> keep(num_rows);
+
+    for (int level = 1; level < NUM_LOD_LEVELS; ++level) {
+        double tolerance = lod_tolerances[level - 1];
+
+        #pragma omp parallel for schedule(dynamic, 256)
+        for (int row = 0; row < num_rows; ++row) {
+            int first = base.offsets[row];
+            int count = base.offsets[row + 1] - first;
+            const double* x = base.x.data() + first;
+            const double* y = base.y.data() + first;
+            simplify_polyline(x, y, count, tolerance, keep[row]);
+
+            bool closed = count >= 3 && x[0] == x[count - 1] && y[0] == y[count - 1];
+            if (closed) {
+                double width = *std::max_element(x, x + count) - *std::min_element(x, x + count);
+                double height = *std::max_element(y, y + count) - *std::min_element(y, y + count);
+                if (keep[row].size() < 4 || std::max(width, height) < tolerance) {
+                    keep[row].clear();
+                }
+            }
+        }
+
+        ProjectedPolylines& polylines = pyramid.levels[level - 1];
+        polylines.offsets.resize(num_rows + 1);
+        polylines.offsets[0] = 0;
+        for (int row = 0; row < num_rows; ++row) {
+            polylines.offsets[row + 1] = polylines.offsets[row] + keep[row].size();
+        }
+        polylines.x.resize(polylines.offsets[num_rows]);
+        polylines.y.resize(polylines.offsets[num_rows]);
+
+        #pragma omp parallel for schedule(dynamic, 256)
+        for (int row = 0; row < num_rows; ++row) {
+            int first = base.offsets[row];
+            for (int k = 0; k < keep[row].size(); ++k) {
+                polylines.x[polylines.offsets[row] + k] = base.x[first + keep[row][k]];
+                polylines.y[polylines.offsets[row] + k] = base.y[first + keep[row][k]];
+            }
+        }
+    }
+}
+
+// called from loadMap after load_projected_geometry
+void load_lod_geometry() {
+    build_lod_pyramid(feature_xy, feature_lod);
+    build_lod_pyramid(segment_xy, segment_lod);
+    lod_level = 0;
+}
+
+void clear_lod_geometry() {
+    feature_lod = LODPyramid();
+    segment_lod = LODPyramid();
+    lod_level = 0;
+}
+
+// pick the coarsest level whose tolerance is under LOD_PIXEL_ERROR of a pixel, called once per frame
+void select_lod_level(ezgl::renderer* g) {
+    double world_per_pixel = 1.0 / distance_scaling_fct(g);
+    lod_level = 0;
+    while (lod_level + 1 < NUM_LOD_LEVELS && lod_tolerances[lod_level] <= LOD_PIXEL_ERROR * world_per_pixel) {
+        lod_level++;
+    }
+}
+
+// the polylines to draw at the current level, base is the full geometry the pyramid was built from
+const ProjectedPolylines& lod_polylines(const LODPyramid& pyramid, const ProjectedPolylines& base) {
+    if (lod_level == 0 || pyramid.levels.empty()) {
+        return base;
+    }
+    return pyramid.levels[lod_level - 1];
+}
@@ -21,6 +21,9 @@
 
 #include "global.h"
 
+// gallop through the longer street's intersections when it is this many times longer
+#define GALLOP_RATIO 16
+
 // loadMap will be called with the name of the file that stores the "layer-2"
 // map data accessed through StreetsDatabaseAPI: the street and intersection 
 // data that is higher-level than the raw OSM data). 
@@ -35,9 +38,11 @@
 // name.
 
 // Initialize value here
-std::vector<std::vector<StreetSegmentIdx>> intersection_street_segments;
-std::vector<std::vector<IntersectionIdx>> street_intersections;
+CompactAdjacency<StreetSegmentIdx> intersection_street_segments;
+CompactAdjacency<IntersectionIdx> street_intersections;
 std::vector<std::vector<StreetSegmentIdx>> street_segments;
+SegmentGeometryTable segment_geometry;
+std::vector<double> street_length;
 std::vector<std::vector<StreetIdx>> intersection_street_id;
 
 //Build OSM Database Functions
@@ -50,35 +55,29 @@ std::vector<OSMID> NodeIndex_OSMId;
 std::vector<const OSMWay*> WayIndex_WayId;
 std::vector<OSMID> WayIndex_OSMId;
 
+//buildRelationData vectors
+std::vector<const OSMRelation*> RelationIndex_RelationId;
+std::vector<OSMID> RelationIndex_OSMId;
+
+//OSMID -> index hashes, built with the vectors above
+OSMIdIndex node_osmid_index;
+OSMIdIndex way_osmid_index;
+OSMIdIndex relation_osmid_index;
+
 //load_Way_LatLon_of_Nodes and load_Way_WayLength vectors
 std::vector<std::vector<LatLon>> Way_LatLon_of_Nodes;
 std::vector<std::vector<double>> Way_WayLength;
 
 //m2.cpp
-std::vector<FeatureIdx> parks;
-std::vector<FeatureIdx> lakes;
-std::vector<FeatureIdx> rivers;
-std::vector<FeatureIdx> beaches;
-std::vector<FeatureIdx> islands;
-std::vector<FeatureIdx> buildings;
-std::vector<FeatureIdx> greenspaces;
-std::vector<FeatureIdx> golfcourses;
-std::vector<FeatureIdx> streams;
-std::vector<FeatureIdx> glaciers;
+CompactAdjacency<FeatureIdx> feature_buckets;
 
 std::vector<LatLon> subway_stations;
 std::vector<std::pair<LatLon, std::string >> toilets;
 std::vector<std::pair<LatLon, std::string >> toilets_wheelchair;
-std::vector<std::pair<LatLon, LatLon>> subway_nodes;
 std::vector<std::string>maps;
 std::vector<Intersection_data> intersections;
 
 //initialize the variables here
-ezgl::surface *surface_subway;
-ezgl::surface *surface_toilet_wheelchair;
-ezgl::surface *surface_toilet;
-ezgl::surface *surface_location;
-ezgl::renderer* icon_g;
 
 double avg_lat;
 double max_lat;
@@ -134,36 +133,29 @@ bool loadMap(std::string map_streets_database_filename) {
     load_street_intersections();
     load_street_segments();
     load_intersection_street_id();
+    load_point_arrays();
+    load_segment_geometry();
     load_segment_time();
+    load_fuzzy_search_index();
 
 
 
-    initial_parks();
-    initial_lakes();
-    initial_rivers();
-    initial_beaches();
-    initial_islands();
-    initial_buildings();
-    initial_greenspaces();
-    initial_golfcourses();
-    initial_streams();
-    initial_glaciers();
 
-    SUBWAY_OSM_Database();
-    toilet_OSM_Database();
-    toilets_wheelchair_OSM_Database();
-
-    init_subway_route();
-
-    load_subway_png();
-    load_toilet_png();
-    load_toilet_wheelchair_png();
-    load_location_png();
+    load_osm_layers();
+    load_road_classes();
+    load_icon_atlas();
 
     load_max_min_lat_lon();
+    load_projected_geometry();
+    load_feature_metadata();
+    load_feature_buckets();
+    load_spatial_index();
+    load_icon_layers();
+    load_lod_geometry();
+    load_label_engine();
+    initial_intersections();
 
     //m3.cpp
-    initial_segment_highlighted();
     init_nodes();
 
     load_successful = true; //Make sure this is updated to reflect whether
@@ -177,23 +169,21 @@ void load_intersection_street_segments () {
     //get the number of intersection
     int numIntersections = getNumIntersections();
 
-    //create a vector for street_segment_ids
-    std::vector<StreetSegmentIdx> street_segment_ids;
-
-    //resize the vector intersection_street_segments with size: the number of the intersection
-    intersection_street_segments.resize(numIntersections);
-
-    //loop through all intersections to get the number of segments of each intersection
+    //one row per intersection, filled in intersection order so the rows are contiguous
+    intersection_street_segments.offsets.resize(numIntersections + 1);
+    intersection_street_segments.offsets[0] = 0;
     for (int intersection = 0; intersection < numIntersections; ++intersection) {
-        int numSegmentsAtIntersection = getNumIntersectionStreetSegment(intersection);
-
-        //loop through all street segments
-        //to get each StreetSegmentIdx at one intersection
-        for (int i = 0; i < numSegmentsAtIntersection; ++i) {
-            StreetSegmentIdx ss_id = getIntersectionStreetSegment(i, intersection);
+        intersection_street_segments.offsets[intersection + 1] = intersection_street_segments.offsets[intersection]
+                                                                 + getNumIntersectionStreetSegment(intersection);
+    }
+    intersection_street_segments.values.resize(intersection_street_segments.offsets[numIntersections]);
 
-            //push back the value into the vector
-            intersection_street_segments[intersection].push_back(ss_id);
+    //loop through all street segments
+    //to get each StreetSegmentIdx at one intersection
+    for (int intersection = 0; intersection < numIntersections; ++intersection) {
+        int first = intersection_street_segments.offsets[intersection];
+        for (int i = 0; i < intersection_street_segments.offsets[intersection + 1] - first; ++i) {
+            intersection_street_segments.values[first + i] = getIntersectionStreetSegment(i, intersection);
         }
     }
 }
@@ -204,40 +194,44 @@ void load_street_intersections () {
     int numStreets = getNumStreets();
     int numIntersection = getNumIntersections();
 
-    //create a vector for intersectionID
-    std::vector<IntersectionIdx> intersection_ids;
-
-    //resize the street_intersections vector
-    street_intersections.resize(numStreets);
-
-    //loop through all intersections to get all segments for each intersection
-    for (int intersection = 0; intersection < numIntersection; ++ intersection) {
-        int numSegmentsAtIntersection = getNumIntersectionStreetSegment(intersection);
+    // intersections are visited in increasing order, so each street's row stays sorted
+    // and a duplicate can only be the last intersection added for that street
+    std::vector<IntersectionIdx> last_added(numStreets, -1);
+
+    //first pass counts the intersections of every street, second pass fills the rows
+    std::vector<int> row_size(numStreets, 0);
+    for (int pass = 0; pass < 2; ++pass) {
+        if (pass == 1) {
+            street_intersections.offsets.resize(numStreets + 1);
+            street_intersections.offsets[0] = 0;
+            for (int st_id = 0; st_id < numStreets; ++st_id) {
+                street_intersections.offsets[st_id + 1] = street_intersections.offsets[st_id] + row_size[st_id];
+                row_size[st_id] = 0;
+                last_added[st_id] = -1;
+            }
+            street_intersections.values.resize(street_intersections.offsets[numStreets]);
+        }
 
-        //loop through to get the street segment ID
-        //then get the streetID
-        for (int i = 0; i < numSegmentsAtIntersection; ++i) {
-            StreetSegmentIdx ss_id = getIntersectionStreetSegment(i, intersection);
-            StreetIdx st_id = getStreetSegmentInfo(ss_id).streetID;
+        //loop through all intersections to get all segments for each intersection
+        for (int intersection = 0; intersection < numIntersection; ++intersection) {
+            IndexSpan<StreetSegmentIdx> segments = street_segments_of_intersection(intersection);
 
-            street_intersections[st_id].push_back(intersection);
+            //get the streetID of every segment
+            for (int i = 0; i < segments.size(); ++i) {
+                StreetIdx st_id = getStreetSegmentInfo(segments[i]).streetID;
+                if (last_added[st_id] == intersection) {
+                    continue;
+                }
+                last_added[st_id] = intersection;
 
-            //loop through to find the same value in the vector in order
-//            // ex. [3,5,3,6,7,1,] -> [1, 3, 3, 6, 7]
-//            auto sameIntersection = std::unique(street_intersections[st_id].begin(),
-//                                                street_intersections[st_id].end());
-//            //erase the same value in the vector
-//            street_intersections[st_id].erase(sameIntersection, street_intersections[st_id].end());
+                if (pass == 1) {
+                    street_intersections.values[street_intersections.offsets[st_id] + row_size[st_id]] = intersection;
+                }
+                ++row_size[st_id];
+            }
         }
     }
 
-
-    // Remove duplicates from each street's intersection vector
-    for (auto& intersection_vector : street_intersections) {
-        auto uniqueEnd = std::unique(intersection_vector.begin(), intersection_vector.end());
-        intersection_vector.erase(uniqueEnd, intersection_vector.end());
-    }
-
 }
 
 void load_street_segments(){
@@ -266,6 +260,71 @@ void load_street_segments(){
     }
 }
 
+// direction from one point to the other in radians, counterclockwise from east
+double bearing_between(LatLon from, LatLon to) {
+    double lat_avg = (from.latitude() + to.latitude()) / 2.0 * kDegreeToRadian;
+    double dx = (to.longitude() - from.longitude()) * kDegreeToRadian * cos(lat_avg);
+    double dy = (to.latitude() - from.latitude()) * kDegreeToRadian;
+    return atan2(dy, dx);
+}
+
+// fill the geometry of every segment, then the length of every street
+void load_segment_geometry() {
+    int numSegments = getNumStreetSegments();
+
+    segment_geometry.length.resize(numSegments);
+    segment_geometry.travel_time.resize(numSegments);
+    segment_geometry.start_bearing.resize(numSegments);
+    segment_geometry.end_bearing.resize(numSegments);
+    segment_geometry.min_lat.resize(numSegments);
+    segment_geometry.max_lat.resize(numSegments);
+    segment_geometry.min_lon.resize(numSegments);
+    segment_geometry.max_lon.resize(numSegments);
+    segment_geometry.street_id.resize(numSegments);
+    segment_geometry.from.resize(numSegments);
+    segment_geometry.to.resize(numSegments);
+
+    #pragma omp parallel for schedule(dynamic, 1024)
+    for (int i = 0; i < numSegments; ++i) {
+        StreetSegmentInfo info = getStreetSegmentInfo(i);
+        LatLon from = getIntersectionPosition(info.from);
+        LatLon to = getIntersectionPosition(info.to);
+
+        segment_geometry.length[i] = compute_street_segment_length(i);
+        segment_geometry.travel_time[i] = segment_geometry.length[i] / info.speedLimit;
+        segment_geometry.street_id[i] = info.streetID;
+        segment_geometry.from[i] = info.from;
+        segment_geometry.to[i] = info.to;
+
+        // the first and last pieces of the segment give its bearings
+        LatLon first_point = (info.numCurvePoints > 0) ? getStreetSegmentCurvePoint(0, i) : to;
+        LatLon last_point = (info.numCurvePoints > 0) ? getStreetSegmentCurvePoint(info.numCurvePoints - 1, i) : from;
+        segment_geometry.start_bearing[i] = bearing_between(from, first_point);
+        segment_geometry.end_bearing[i] = bearing_between(last_point, to);
+
+        double min_lat = std::min(from.latitude(), to.latitude());
+        double max_lat = std::max(from.latitude(), to.latitude());
+        double min_lon = std::min(from.longitude(), to.longitude());
+        double max_lon = std::max(from.longitude(), to.longitude());
+        for (int k = 0; k < info.numCurvePoints; ++k) {
+            LatLon point = getStreetSegmentCurvePoint(k, i);
+            min_lat = std::min(min_lat, point.latitude());
+            max_lat = std::max(max_lat, point.latitude());
+            min_lon = std::min(min_lon, point.longitude());
+            max_lon = std::max(max_lon, point.longitude());
+        }
+        segment_geometry.min_lat[i] = min_lat;
+        segment_geometry.max_lat[i] = max_lat;
+        segment_geometry.min_lon[i] = min_lon;
+        segment_geometry.max_lon[i] = max_lon;
+    }
+
+    street_length.assign(getNumStreets(), 0.0);
+    for (int i = 0; i < numSegments; ++i) {
+        street_length[segment_geometry.street_id[i]] += segment_geometry.length[i];
+    }
+}
+
 void load_intersection_street_id() {
 
     //get the number of the Intersection
@@ -293,45 +352,51 @@ void load_intersection_street_id() {
 void closeMap() {
     //Clean-up your map related data structures here
 
+    //the tile workers draw from the map data, stop them first
+    clear_tile_cache();
+
     //clear the vectors
-    std::vector<std::vector<StreetSegmentIdx>>().swap(intersection_street_segments);
-    std::vector<std::vector<IntersectionIdx>>().swap(street_intersections);
+    intersection_street_segments = CompactAdjacency<StreetSegmentIdx>();
+    street_intersections = CompactAdjacency<IntersectionIdx>();
     std::vector<std::vector<StreetSegmentIdx>>().swap(street_segments);
+    segment_geometry = SegmentGeometryTable();
+    std::vector<double>().swap(street_length);
     std::vector<std::vector<StreetIdx>>().swap(intersection_street_id);
+    clear_fuzzy_search_index();
+    clear_point_arrays();
+    clear_projected_geometry();
+    clear_spatial_index();
+    clear_lod_geometry();
+    clear_label_engine();
+    clear_icon_layers();
+    clear_road_classes();
     //m2.cpp
+    invalidate_base_layer();
+    clear_route_overlay();
     std::vector<Intersection_data>().swap(intersections);
-    std::vector<FeatureIdx>().swap(parks);
-    std::vector<FeatureIdx>().swap(lakes);
-    std::vector<FeatureIdx>().swap(rivers);
-    std::vector<FeatureIdx>().swap(beaches);
-    std::vector<FeatureIdx>().swap(islands);
-    std::vector<FeatureIdx>().swap(buildings);
-    std::vector<FeatureIdx>().swap(greenspaces);
-    std::vector<FeatureIdx>().swap(golfcourses);
-    std::vector<FeatureIdx>().swap(streams);
-    std::vector<FeatureIdx>().swap(glaciers);
+    feature_buckets = CompactAdjacency<FeatureIdx>();
     std::vector<LatLon>().swap(subway_stations);
     std::vector<std::pair<LatLon, std::string >>().swap(toilets);
     std::vector<std::pair<LatLon, std::string >>().swap(toilets_wheelchair);
-    std::vector<std::pair<LatLon, LatLon>>().swap(subway_nodes);
 
     std::vector<const OSMNode*>().swap(NodeIndex_NodeId);
     std::vector<OSMID>().swap(NodeIndex_OSMId);
     std::vector<const OSMWay*>().swap(WayIndex_WayId);
     std::vector<OSMID>().swap(WayIndex_OSMId);
+    std::vector<const OSMRelation*>().swap(RelationIndex_RelationId);
+    std::vector<OSMID>().swap(RelationIndex_OSMId);
+    node_osmid_index = OSMIdIndex();
+    way_osmid_index = OSMIdIndex();
+    relation_osmid_index = OSMIdIndex();
+    clear_osm_tags();
     std::vector<std::vector<LatLon>>().swap(Way_LatLon_of_Nodes);
     std::vector<std::vector<double>>().swap(Way_WayLength);
 
-    icon_g->free_surface(surface_subway);
-    icon_g->free_surface(surface_toilet_wheelchair);
-    icon_g->free_surface(surface_toilet);
-    icon_g->free_surface(surface_location);
 
     //m3.cpp
     find_path_pressed = false;
     std::vector<std::pair<StreetIdx, double>>().swap(segment_time);
     std::vector<IntersectionIdx>().swap(highlighted);
-    std::vector<bool>().swap(segment_highlighted);
     std::vector<Node>().swap(Nodes);
 
     //Close the database
@@ -374,49 +439,25 @@ double findDistanceBetweenTwoPoints(LatLon point_1, LatLon point_2) {
 // Speed Requirement --> moderate
 // COMPLETED
 double findStreetSegmentLength(StreetSegmentIdx street_segment_id) {
-    StreetSegmentInfo segmentLengthStrName = getStreetSegmentInfo(street_segment_id);
-
-    // find the intersections that make this street segment
-    IntersectionIdx start_of_StreetSegID = segmentLengthStrName.from;
-    IntersectionIdx end_of_StreetSegID = segmentLengthStrName.to;
-
-    // determine the LatLon position of these intersections
-    LatLon start_StreetSegId_Coord = getIntersectionPosition(start_of_StreetSegID);
-    LatLon end_StreetSegId_Coord = getIntersectionPosition (end_of_StreetSegID);
-
-
-    // get number of curves in this street segment
-    int numCurvesInSeg = getStreetSegmentInfo(street_segment_id).numCurvePoints;
-
-    // store the total street segment length
-    double totalStreetSegLength = 0.0;
-
-    // prev and next variables to keep up
-    LatLon prevStreetPoint = start_StreetSegId_Coord;
-
-    LatLon nextStreetPoint;
-
-    // create a for loop that calculates the distance of these
-    if (numCurvesInSeg != 0) {
-        for (int i = 0; i < numCurvesInSeg; i++) {
-            nextStreetPoint = getStreetSegmentCurvePoint(i, street_segment_id);
-
-            // find distance between these points
-            double distanceAtCurve = findDistanceBetweenTwoPoints (prevStreetPoint, nextStreetPoint);
-            
-            totalStreetSegLength += distanceAtCurve;
-            // update prevStreetPoint
-            prevStreetPoint = nextStreetPoint;
-        }
+    return segment_geometry.length[street_segment_id];
+}
 
-        // add the last distance from last curve point to 2nd intersection
-        totalStreetSegLength = totalStreetSegLength + findDistanceBetweenTwoPoints (prevStreetPoint, end_StreetSegId_Coord);
-    } else {
-        // straight path with no curves
-        totalStreetSegLength = findDistanceBetweenTwoPoints (start_StreetSegId_Coord, end_StreetSegId_Coord);
+// length of the segment from its curve points, used to fill segment_geometry
+double compute_street_segment_length(StreetSegmentIdx street_segment_id) {
+    StreetSegmentInfo info = getStreetSegmentInfo(street_segment_id);
+
+    // from intersection, the curve points, then the to intersection
+    static thread_local std::vector<LatLon> points;
+    static thread_local PointArray point_array;
+    points.clear();
+    points.push_back(getIntersectionPosition(info.from));
+    for (int i = 0; i < info.numCurvePoints; i++) {
+        points.push_back(getStreetSegmentCurvePoint(i, street_segment_id));
     }
+    points.push_back(getIntersectionPosition(info.to));
 
-    return totalStreetSegLength;
+    build_point_array(points, point_array);
+    return polyline_length(point_array);
 }
 
 // Returns the travel time to drive from one end of a street segment
@@ -425,14 +466,8 @@ double findStreetSegmentLength(StreetSegmentIdx street_segment_id) {
 // Speed Requirement --> high
 // COMPLETED
 double findStreetSegmentTravelTime(StreetSegmentIdx street_segment_id) {
-
-    //distance -> findStreetSegmentLength(street_segment_id)
-    //speed_limit -> getStreetSegmentInfo(street_segment_id).speedLimit
-    //time = distance/speed_limit
-    double travelTime = findStreetSegmentLength(street_segment_id)/
-            (getStreetSegmentInfo(street_segment_id).speedLimit);
-
-    return travelTime;
+    //time = distance/speed_limit, computed in load_segment_geometry
+    return segment_geometry.travel_time[street_segment_id];
 }
 
 // Returns the angle (in radians) that would result as you exit
@@ -447,306 +482,50 @@ double findStreetSegmentTravelTime(StreetSegmentIdx street_segment_id) {
 double findAngleBetweenStreetSegments(StreetSegmentIdx src_street_segment_id,
                                       StreetSegmentIdx dst_street_segment_id){
 
-    //check if two street segments share an intersection
-    int sameIntersection = 0; //check if share the intersection
-    double angleBetweenStreetSeg = 0.0;
-
-    //get the given two street segments' beginning intersections and the ending intersections
-    IntersectionIdx intersection_src_from = getStreetSegmentInfo(src_street_segment_id).from;
-    IntersectionIdx intersection_src_to = getStreetSegmentInfo(src_street_segment_id).to;
-    IntersectionIdx intersection_dst_from = getStreetSegmentInfo(dst_street_segment_id).from;
-    IntersectionIdx intersection_dst_to = getStreetSegmentInfo(dst_street_segment_id).to;
-
-    //get each intersections' latitude and longitude
-    LatLon position_src_from = getIntersectionPosition(getStreetSegmentInfo(src_street_segment_id).from);
-    LatLon position_src_to = getIntersectionPosition(getStreetSegmentInfo(src_street_segment_id).to);
-    LatLon position_dst_from = getIntersectionPosition(getStreetSegmentInfo(dst_street_segment_id).from);
-    LatLon position_dst_to = getIntersectionPosition(getStreetSegmentInfo(dst_street_segment_id).to);
-
-
-    //list four situations if two street segments have the shared intersection
-
-    // the first situation: the 'from' intersection of src_street_segment
-    // is connected to the 'to' intersection of dst_street_segment
-    if (intersection_src_from == intersection_dst_to) sameIntersection = 1;
-
-    // the second situation: the 'from' intersection of src_street_segment
-    // is connected to the 'from' intersection of dst_street_segment
-    if (intersection_src_from == intersection_dst_from) sameIntersection = 2;
-
-    // the second situation: the 'to' intersection of src_street_segment
-    // is connected to the 'to' intersection of dst_street_segment
-    if (intersection_src_to == intersection_dst_to) sameIntersection = 3;
-
-    // the second situation: the 'to' intersection of src_street_segment
-    // is connected to the 'from' intersection of dst_street_segment
-    if (intersection_src_to == intersection_dst_from) sameIntersection = 4;
+    double turn = signed_turn_angle(src_street_segment_id, dst_street_segment_id);
 
     //if there is no intersection shared, return
-    if (sameIntersection == 0) {return 0.0;}
-
-    // access the number of curve point for each street segment
-    int numCurves_src = getStreetSegmentInfo( src_street_segment_id).numCurvePoints;
-    int numCurves_dst = getStreetSegmentInfo(dst_street_segment_id).numCurvePoints;
-
-    //If both street segment has no curve point
-    if ((numCurves_dst == 0) && (numCurves_src == 0)) {
-
-        //the first situation
-        if(sameIntersection == 1) {
-
-            //Using th Cosine Law to find the angle
-
-            //get each length of triangle
-            double a = findDistanceBetweenTwoPoints(position_src_from, position_src_to);
-            double b = findDistanceBetweenTwoPoints(position_dst_to, position_dst_from);
-            double c = findDistanceBetweenTwoPoints(position_src_to, position_dst_from);
-
-
-            //angle between two street segment -> CosineLaw(a, b, c)
-            //store the angle when you exit the src_street_segment and into the dst_street_segment
-            //-> 2pi - angle
-            angleBetweenStreetSeg = M_PI - CosineLaw(a, b, c);
-
-        }
-
-        //second situation
-        if (sameIntersection == 2) {
-
-            // get the length of the triangle
-            double a = findDistanceBetweenTwoPoints(position_src_from, position_src_to);
-            double b = findDistanceBetweenTwoPoints(position_dst_to, position_dst_from);
-            double c = findDistanceBetweenTwoPoints(position_src_to, position_dst_to);
-
-            //store angle value
-            angleBetweenStreetSeg = M_PI - CosineLaw(a, b, c);
-        }
-
-        //third situation
-        if (sameIntersection == 3) {
-
-            // get the length of the triangle
-            double a = findDistanceBetweenTwoPoints(position_src_from, position_src_to);
-            double b = findDistanceBetweenTwoPoints(position_dst_to, position_dst_from);
-            double c = findDistanceBetweenTwoPoints(position_src_from, position_dst_from);
-
-            //store angle value
-            angleBetweenStreetSeg = M_PI - CosineLaw(a, b, c);
-
-        }
-
-        //fourth situation
-        if (sameIntersection == 4) {
-
-            // get the length of the triangle
-            double a = findDistanceBetweenTwoPoints( position_src_from,position_src_to);
-            double b = findDistanceBetweenTwoPoints(position_dst_from, position_dst_to);
-            double c = findDistanceBetweenTwoPoints(position_src_from, position_dst_to);
-
-            //store angle value
-            angleBetweenStreetSeg = M_PI - CosineLaw(a, b, c);
-        }
-    }
-
-    //If at least one of the street segment has curve point
-
-    else {
-        int pointNum_src = getStreetSegmentInfo(src_street_segment_id).numCurvePoints;
-        int pointNum_dst = getStreetSegmentInfo(dst_street_segment_id).numCurvePoints;
-
-        // src_street_segment has curve point
-        if ((numCurves_dst == 0) && (numCurves_src != 0)) {
-
-            // firstly, get the longitude and latitude of the curve point that would be used in this situation
-            LatLon curvePoint_src_first = getStreetSegmentCurvePoint(0, src_street_segment_id);
-            LatLon curvePoint_src_last = getStreetSegmentCurvePoint(pointNum_src-1, src_street_segment_id);
-
-            //first situation
-            if (sameIntersection == 1) {
-
-                //get the length
-                double a = findDistanceBetweenTwoPoints(position_src_from, curvePoint_src_first);
-                double b = findDistanceBetweenTwoPoints(position_dst_to, position_dst_from);
-                double c = findDistanceBetweenTwoPoints(curvePoint_src_first, position_dst_from);
-
-                //store the value
-                angleBetweenStreetSeg = M_PI - CosineLaw(a, b, c);
-            }
+    if (turn == NO_ANGLE) {return 0.0;}
 
-            //second situation
-            else if (sameIntersection == 2) {
-
-                //get the length
-                double a = findDistanceBetweenTwoPoints(position_src_from, curvePoint_src_first);
-                double b = findDistanceBetweenTwoPoints(position_dst_from, position_dst_to);
-                double c = findDistanceBetweenTwoPoints(curvePoint_src_first, position_dst_to);
-
-                //store the value
-                angleBetweenStreetSeg = M_PI - CosineLaw( a,  b,  c);
-            }
-
-            //third situation
-            else if (sameIntersection == 3) {
-
-                //get the length
-                double a = findDistanceBetweenTwoPoints(position_src_to, curvePoint_src_last);
-                double b = findDistanceBetweenTwoPoints(position_dst_to, position_dst_from);
-                double c = findDistanceBetweenTwoPoints(curvePoint_src_last, position_dst_from);
-
-                //store the value
-                angleBetweenStreetSeg = M_PI- CosineLaw( a,  b,  c);
-            }
-
-            //fourth situation
-            else if (sameIntersection == 4) {
-
-                //get the length
-                double a = findDistanceBetweenTwoPoints(position_src_to, curvePoint_src_last);
-                double b = findDistanceBetweenTwoPoints(position_dst_from, position_dst_to);
-                double c = findDistanceBetweenTwoPoints(curvePoint_src_last, position_dst_to);
-
-                //store the value
-                angleBetweenStreetSeg = M_PI - CosineLaw( a,  b,  c);
-
-            }
-        }
-
-        //dst street segment has the curve point
-        else if ((numCurves_dst != 0) && (numCurves_src == 0)) {
-
-            // firstly, get the longitude and latitude of the curve point that would be used in this situation
-            LatLon curvePoint_dst_first = getStreetSegmentCurvePoint(0, dst_street_segment_id);
-            LatLon curvePoint_dst_last = getStreetSegmentCurvePoint(pointNum_dst-1, dst_street_segment_id);
-
-            //first situation
-            if (sameIntersection == 1) {
-
-                //get the length of the triangle
-                double a = findDistanceBetweenTwoPoints(position_src_from, position_src_to);
-                double b = findDistanceBetweenTwoPoints(position_dst_to, curvePoint_dst_last);
-                double c = findDistanceBetweenTwoPoints(position_src_to, curvePoint_dst_last);
-
-                //store the angle
-                angleBetweenStreetSeg = M_PI - CosineLaw( a,  b,  c);
-
-            }
-
-            //second situation
-            else if (sameIntersection == 2) {
-
-                //get the length of the triangle
-                double a = findDistanceBetweenTwoPoints(position_src_from, position_src_to);
-                double b = findDistanceBetweenTwoPoints(position_dst_from, curvePoint_dst_first);
-                double c = findDistanceBetweenTwoPoints(position_src_to, curvePoint_dst_first);
-
-                //store the angle
-                angleBetweenStreetSeg = M_PI - CosineLaw( a,  b,  c);
-            }
-
-            //third situation
-            else if (sameIntersection == 3) {
-
-                //get the length of the triangle
-                double a = findDistanceBetweenTwoPoints(position_src_to, position_src_from);
-                double b = findDistanceBetweenTwoPoints(position_dst_to, curvePoint_dst_last);
-                double c = findDistanceBetweenTwoPoints(position_src_from, curvePoint_dst_last);
-
-                //store the angle
-                angleBetweenStreetSeg = M_PI - CosineLaw( a,  b,  c);
-            }
-
-            //fourth situation
-            else if (sameIntersection == 4) {
-
-                //get the length of the triangle
-                double a = findDistanceBetweenTwoPoints(position_src_to, position_src_from);
-                double b = findDistanceBetweenTwoPoints(position_dst_from, curvePoint_dst_first);
-                double c = findDistanceBetweenTwoPoints(position_src_from, curvePoint_dst_first);
-
-                //store the angle
-                angleBetweenStreetSeg = M_PI - CosineLaw( a,  b , c);
-            }
-        }
-
-        //if both street segment has the curve point
-        else if ((numCurves_dst != 0) && (numCurves_src != 0)) {
-
-            //get the latitude and longitude of curve point
-            LatLon curvePoint_src_first = getStreetSegmentCurvePoint(0, src_street_segment_id);
-            LatLon curvePoint_dst_first = getStreetSegmentCurvePoint(0, dst_street_segment_id);
-            LatLon curvePoint_src_last = getStreetSegmentCurvePoint(pointNum_src-1, src_street_segment_id);
-            LatLon curvePoint_dst_last = getStreetSegmentCurvePoint(pointNum_dst-1, dst_street_segment_id);
-
-            //first situation
-            if (sameIntersection == 1) {
-
-                //get the length
-                double a = findDistanceBetweenTwoPoints(curvePoint_src_first, position_src_from);
-                double b = findDistanceBetweenTwoPoints(position_dst_to, curvePoint_dst_last);
-                double c = findDistanceBetweenTwoPoints(curvePoint_src_first, curvePoint_dst_last);
-
-                //store the value
-                angleBetweenStreetSeg = M_PI - CosineLaw( a,  b,  c);
-           }
-
-            //second situation
-            else if (sameIntersection == 2) {
-
-                //get the length
-                double a = findDistanceBetweenTwoPoints(position_src_from, curvePoint_src_first);
-                double b = findDistanceBetweenTwoPoints(position_dst_from, curvePoint_dst_first);
-                double c = findDistanceBetweenTwoPoints(curvePoint_src_first, curvePoint_dst_first);
-
-                //store the value
-                angleBetweenStreetSeg = M_PI - CosineLaw( a,  b,  c);
-            }
-
-            //third situation
-            else if (sameIntersection == 3) {
-
-                //get the length
-                double a = findDistanceBetweenTwoPoints(position_src_to, curvePoint_src_last);
-                double b = findDistanceBetweenTwoPoints(position_dst_to, curvePoint_dst_last);
-                double c = findDistanceBetweenTwoPoints(curvePoint_src_last, curvePoint_dst_last);
-
-                //store the value
-                angleBetweenStreetSeg = M_PI - CosineLaw( a,  b,  c);
-            }
-
-            //the last situation
-            else if (sameIntersection == 4) {
-
-                //get the length
-                double a = findDistanceBetweenTwoPoints(position_src_to, curvePoint_src_last);
-                double b = findDistanceBetweenTwoPoints(position_dst_from, curvePoint_dst_first);
-                double c = findDistanceBetweenTwoPoints(curvePoint_src_last, curvePoint_dst_first);
-
-                //get the value
-                angleBetweenStreetSeg = M_PI - CosineLaw( a,  b,  c);
-            }
-        }
-    }
-
-    //return the angle
-    return angleBetweenStreetSeg;
+    return std::abs(turn);
 }
 
-//Helper function for findAngleBetweenStreetSegments function
-//Apply the Cosine Law to find the angle between two street segment
-double CosineLaw(double a, double b, double c){
-
-    double theta = 0.0;
-
-    //Cosine Law:
-    double cosine_theta = (a * a + b * b - c * c) / (2 * a * b);
-
-    //Since cosine range from 1 to -1, set the angle value if out of the range
-    if(cosine_theta >= 1.0) theta = M_PI;
-    else if(cosine_theta <= -1.0) theta = M_PI;
-    else theta = acos(cosine_theta);
+//Helper function for findAngleBetweenStreetSegments and find_turn_to
+//Change of direction in radians at the shared intersection, in (-pi, pi]:
+//positive turns left (counterclockwise), negative turns right.
+//Returns NO_ANGLE if the two street segments do not share an intersection.
+//Only subtracts the bearings of the segment ends filled in load_segment_geometry
+double signed_turn_angle(StreetSegmentIdx src_street_segment_id, StreetSegmentIdx dst_street_segment_id) {
+    IntersectionIdx src_from = segment_geometry.from[src_street_segment_id];
+    IntersectionIdx src_to = segment_geometry.to[src_street_segment_id];
+    IntersectionIdx dst_from = segment_geometry.from[dst_street_segment_id];
+    IntersectionIdx dst_to = segment_geometry.to[dst_street_segment_id];
+
+    //the direction src arrives at the shared intersection and dst leaves it,
+    //a segment used from its 'to' end is travelled against its bearings (+ pi)
+    double in_bearing;
+    double out_bearing;
+    if (src_to == dst_from) {
+        in_bearing = segment_geometry.end_bearing[src_street_segment_id];
+        out_bearing = segment_geometry.start_bearing[dst_street_segment_id];
+    } else if (src_to == dst_to) {
+        in_bearing = segment_geometry.end_bearing[src_street_segment_id];
+        out_bearing = segment_geometry.end_bearing[dst_street_segment_id] + M_PI;
+    } else if (src_from == dst_from) {
+        in_bearing = segment_geometry.start_bearing[src_street_segment_id] + M_PI;
+        out_bearing = segment_geometry.start_bearing[dst_street_segment_id];
+    } else if (src_from == dst_to) {
+        in_bearing = segment_geometry.start_bearing[src_street_segment_id] + M_PI;
+        out_bearing = segment_geometry.end_bearing[dst_street_segment_id] + M_PI;
+    } else {
+        return NO_ANGLE;
+    }
 
-    //return
-    return theta;
+    //wrap the difference into (-pi, pi]
+    double turn = out_bearing - in_bearing;
+    while (turn > M_PI) turn -= 2 * M_PI;
+    while (turn <= -M_PI) turn += 2 * M_PI;
+    return turn;
 }
 
 // Returns true if the two intersections are directly connected, meaning you can
@@ -779,30 +558,20 @@ bool intersectionsAreDirectlyConnected(std::pair<IntersectionIdx, IntersectionId
 // Speed Requirement --> none
 // COMPLETED
 IntersectionIdx findClosestIntersection(LatLon my_position){
-    // load the number of intersections
-    int numIntersections = getNumIntersections();
-
-    // initialize variables for closest intersection id and distance
-    IntersectionIdx closestIdx = 0;
-    double closestDistance = 99999999;
-
-    // loop through all intersections
-    for (int intersection = 0; intersection < numIntersections; ++intersection) {
-        // find the distance from "intersection" to my_position
-        double Distance = findDistanceBetweenTwoPoints(my_position, getIntersectionPosition(intersection));
-        // if the distance is smaller than comarison value, update closest distance
-        if (Distance < closestDistance){
-            closestDistance = Distance;
-            closestIdx = intersection;
-        }
-    }
-    return closestIdx;
+    // batch distances to every intersection, see distance_kernels.cpp
+    return closest_point(my_position, intersection_points);
 }
 
 // Returns the street segments that connect to the given intersection.
 // Speed Requirement --> high
 // COMPLETED
 std::vector<StreetSegmentIdx> findStreetSegmentsOfIntersection (IntersectionIdx intersection_id){
+    IndexSpan<StreetSegmentIdx> segments = intersection_street_segments[intersection_id];
+    return std::vector<StreetSegmentIdx>(segments.begin(), segments.end());
+}
+
+// same as findStreetSegmentsOfIntersection, but a view into the stored list instead of a copy
+IndexSpan<StreetSegmentIdx> street_segments_of_intersection(IntersectionIdx intersection_id) {
     return intersection_street_segments[intersection_id];
 }
 
@@ -811,6 +580,12 @@ std::vector<StreetSegmentIdx> findStreetSegmentsOfIntersection (IntersectionIdx
 // Speed Requirement --> high
 // COMPLETED
 std::vector<IntersectionIdx> findIntersectionsOfStreet(StreetIdx street_id){
+    IndexSpan<IntersectionIdx> street = street_intersections[street_id];
+    return std::vector<IntersectionIdx>(street.begin(), street.end());
+}
+
+// same as findIntersectionsOfStreet, but a view into the stored list instead of a copy
+IndexSpan<IntersectionIdx> intersections_of_street(StreetIdx street_id) {
     return street_intersections[street_id];
 }
 
@@ -827,26 +602,56 @@ std::vector<IntersectionIdx> findIntersectionsOfTwoStreets(std::pair<StreetIdx,
     StreetIdx street1 = street_ids.first;
     StreetIdx street2 = street_ids.second;
 
-    // initialize vectors to store intersections at street1 and result
-    std::vector<IntersectionIdx> IntersectionsAtStreet1 = findIntersectionsOfStreet(street1);
     std::vector<IntersectionIdx> Result;
+    find_common_intersections(street1, street2, Result);
+
+    return Result;
+}
 
-    // loop through all intersections of street 1
-    for (int i=0; i<IntersectionsAtStreet1.size(); ++i){
-        // load the intersection index along street
-        IntersectionIdx indexAlongTheStreet = IntersectionsAtStreet1[i];
-        std::vector<StreetIdx> street_ids_associated_with_index = intersection_street_id[indexAlongTheStreet];
-        // use find algorithm to find if street2 has the same intersection
-        auto it = std::find(street_ids_associated_with_index.begin(), street_ids_associated_with_index.end(),street2);
-        if (it==street_ids_associated_with_index.end()){
-            //Not found
-            continue;
+// the sorted set intersection of the two streets' intersections, appended to result
+// walks both vectors together, or gallops through the longer one when one street is much shorter
+void find_common_intersections(StreetIdx street1, StreetIdx street2, std::vector<IntersectionIdx>& result) {
+    IndexSpan<IntersectionIdx> shorter = intersections_of_street(street1);
+    IndexSpan<IntersectionIdx> longer = intersections_of_street(street2);
+    if (shorter.size() > longer.size()) {
+        std::swap(shorter, longer);
+    }
+
+    if (shorter.size() * GALLOP_RATIO < longer.size()) {
+        const IntersectionIdx* from = longer.begin();
+        for (int i = 0; i < shorter.size() && from != longer.end(); ++i) {
+            IntersectionIdx target = shorter[i];
+
+            // double the step until it passes the target, then binary search that range
+            int step = 1;
+            const IntersectionIdx* to = from;
+            while (longer.end() - to > step && *(to + step) < target) {
+                to += step;
+                step *= 2;
+            }
+            const IntersectionIdx* last = (longer.end() - to > step) ? to + step + 1 : longer.end();
+            from = std::lower_bound(to, last, target);
+
+            if (from != longer.end() && *from == target) {
+                result.push_back(target);
+                ++from;
+            }
         }
-        //push back indexAlongTheStreet
-        Result.push_back(indexAlongTheStreet);
+        return;
     }
 
-    return Result;
+    int i = 0, j = 0;
+    while (i < shorter.size() && j < longer.size()) {
+        if (shorter[i] < longer[j]) {
+            ++i;
+        } else if (longer[j] < shorter[i]) {
+            ++j;
+        } else {
+            result.push_back(shorter[i]);
+            ++i;
+            ++j;
+        }
+    }
 }
 
 // Returns all street ids corresponding to street names that start with the
@@ -864,21 +669,9 @@ std::vector<IntersectionIdx> findIntersectionsOfTwoStreets(std::pair<StreetIdx,
 //COMPLETED
 std::vector<StreetIdx> findStreetIdsFromPartialStreetName(std::string street_prefix){
 
-    std::vector<StreetIdx>StreetIdsFromPartialStreetName;
-    int numStreets = getNumStreets();
-
-    street_prefix.erase(std::remove_if(street_prefix.begin(),street_prefix.end(),
-                                       ::isspace), street_prefix.end());
-    std::transform(street_prefix.begin(), street_prefix.end(), street_prefix.begin(), ::tolower);
-
-    for (int street = 0; street < numStreets; ++ street) {
-        std::string street_name = getStreetName(street);
-        street_name.erase(std::remove_if(street_name.begin(),street_name.end(),::isspace), street_name.end());
-        std::transform(street_name.begin(), street_name.end(), street_name.begin(), ::tolower);
-        if (street_name.substr(0, street_prefix.length()) == street_prefix) {
-            StreetIdsFromPartialStreetName.push_back(street);
-        }
-    }
+    //the street names are kept sorted in street_name_index, so every match is in one range
+    std::vector<StreetIdx> StreetIdsFromPartialStreetName = find_prefix_matches(street_name_index,
+                                                                                normalize_name(street_prefix));
     if (StreetIdsFromPartialStreetName.size()==0){
         StreetIdsFromPartialStreetName.push_back(-1);
     }
@@ -889,18 +682,8 @@ std::vector<StreetIdx> findStreetIdsFromPartialStreetName(std::string street_pre
 // Speed Requirement --> high
 // COMPLETED
 double findStreetLength(StreetIdx street_id){
-    // get vector size of intersections along street
-    int SegmentsVectorSize = street_segments[street_id].size();
-
-    // variable to store total street length
-    double totalStreetLength = 0.0;
-
-    // loop along all intersections
-    for (int i = 0; i < SegmentsVectorSize; i++) {
-        // add individual segment lengths to totalStreetLength
-        totalStreetLength += findStreetSegmentLength (street_segments[street_id][i]);
-    }
-    return totalStreetLength;
+    // sum of the segment lengths, computed in load_segment_geometry
+    return street_length[street_id];
 }
 
 
@@ -910,24 +693,89 @@ double findStreetLength(StreetIdx street_id){
 void build_OSM_Database() {
     buildNodeData();
     buildWayData();
+    buildRelationData();
+    load_osm_tags();
     load_Way_LatLon_of_Nodes();
     load_Way_WayLength();
 }
 
 void buildNodeData() {
+    NodeIndex_NodeId.reserve(getNumberOfNodes());
+    NodeIndex_OSMId.reserve(getNumberOfNodes());
     for (int i=0; i<getNumberOfNodes(); ++i) {
           const OSMNode* node = getNodeByIndex(i);
           NodeIndex_NodeId.push_back(node);
           NodeIndex_OSMId.push_back(node->id());
     }
+    build_osmid_index(node_osmid_index, NodeIndex_OSMId);
 }
 
 void buildWayData() {
+    WayIndex_WayId.reserve(getNumberOfWays());
+    WayIndex_OSMId.reserve(getNumberOfWays());
     for (int i = 0; i < getNumberOfWays(); ++i) {
         const OSMWay* way = getWayByIndex(i);
         WayIndex_WayId.push_back(way);
         WayIndex_OSMId.push_back(way->id());
     }
+    build_osmid_index(way_osmid_index, WayIndex_OSMId);
+}
+
+void buildRelationData() {
+    RelationIndex_RelationId.reserve(getNumberOfRelations());
+    RelationIndex_OSMId.reserve(getNumberOfRelations());
+    for (int i = 0; i < getNumberOfRelations(); ++i) {
+        const OSMRelation* relation = getRelationByIndex(i);
+        RelationIndex_RelationId.push_back(relation);
+        RelationIndex_OSMId.push_back(relation->id());
+    }
+    build_osmid_index(relation_osmid_index, RelationIndex_OSMId);
+}
+
+// slot of an id in a table of 2^(64 - shift) slots (fibonacci hashing, OSM ids are close to sequential)
+static int osmid_slot(OSMID id, int shift) {
+    return (uint64_t(id) * 0x9E3779B97F4A7C15ull) >> shift;
+}
+
+// builds the hash with at most half of the slots in use, so probe chains stay short
+void build_osmid_index(OSMIdIndex& index, const std::vector<OSMID>& ids) {
+    int bits = 1;
+    while ((1ull << bits) < 2 * ids.size()) {
+        ++bits;
+    }
+    index.shift = 64 - bits;
+    index.slot_ids.assign(1ull << bits, OSMID());
+    index.slot_index.assign(1ull << bits, -1);
+
+    int mask = (1 << bits) - 1;
+    for (int i = 0; i < ids.size(); ++i) {
+        int slot = osmid_slot(ids[i], index.shift);
+        while (index.slot_index[slot] != -1 && index.slot_ids[slot] != ids[i]) {
+            slot = (slot + 1) & mask;
+        }
+        // a repeated id keeps its first index, like the old linear search did
+        if (index.slot_index[slot] == -1) {
+            index.slot_ids[slot] = ids[i];
+            index.slot_index[slot] = i;
+        }
+    }
+}
+
+// index of the entity with this OSMID, or -1 if the map has no such entity
+int find_osmid_index(const OSMIdIndex& index, OSMID id) {
+    if (index.slot_index.empty()) {
+        return -1;
+    }
+
+    int mask = index.slot_index.size() - 1;
+    int slot = osmid_slot(id, index.shift);
+    while (index.slot_index[slot] != -1) {
+        if (index.slot_ids[slot] == id) {
+            return index.slot_index[slot];
+        }
+        slot = (slot + 1) & mask;
+    }
+    return -1;
 }
 
 void load_Way_LatLon_of_Nodes() {
@@ -936,22 +784,14 @@ void load_Way_LatLon_of_Nodes() {
 
     Way_LatLon_of_Nodes.resize(numberOfOSMWays);
 
-    // Create a mapping from OSMID to OSMNode pointer
-    std::unordered_map<OSMID, const OSMNode*> nodeMap;
-    for (int i = 0; i < getNumberOfNodes(); ++i) {
-        const OSMNode* node = getNodeByIndex(i);
-        nodeMap[node->id()] = node;
-    }
-
     for (int i = 0; i < numberOfOSMWays; ++i) {
         const OSMWay* OSMWayID = getWayByIndex(i);
-        std::vector<OSMID> OSMNodes = getWayMembers(OSMWayID);
+        const std::vector<OSMID>& OSMNodes = getWayMembers(OSMWayID);
+        Way_LatLon_of_Nodes[i].reserve(OSMNodes.size());
 
         for (int j = 0; j < OSMNodes.size(); ++j) {
-            OSMID a = OSMNodes[j];
-
-            //Use the mapping to directly get the OSMNode pointer
-            const OSMNode* OSMNodeID = nodeMap[a];
+            //Use the node hash to directly get the OSMNode pointer
+            const OSMNode* OSMNodeID = getNodeById(OSMNodes[j]);
 
             LatLon NodeCord = getNodeCoords(OSMNodeID);
             Way_LatLon_of_Nodes[i].push_back(NodeCord);
@@ -966,36 +806,31 @@ void load_Way_WayLength() {
     int numberOfOSMWays = getNumberOfWays();
     Way_WayLength.resize(numberOfOSMWays);
 
+    //[wayindex][waylength], the length of each way comes from the polyline kernel
+    #pragma omp parallel for schedule(dynamic, 256)
     for (int i = 0; i < numberOfOSMWays; ++i) {
-
-        double wayLength = 0.0;
-        for (int j = 0; j < Way_LatLon_of_Nodes[i].size()-1; ++j) {
-
-            //Way_LatLon_of_Nodes[i] = vector <nodes>
-            LatLon LocationOfNode1 = Way_LatLon_of_Nodes[i][j];
-            LatLon LocationOfNode2 = Way_LatLon_of_Nodes[i][j + 1];
-
-            //Find Way Length For All Way in DataBase
-            double smallSegmentLength= findDistanceBetweenTwoPoints(LocationOfNode1, LocationOfNode2);
-
-            wayLength += smallSegmentLength;
-
-            //[wayindex][waylength]
-        }
-        Way_WayLength[i].push_back(wayLength);
+        static thread_local PointArray way_points;
+        build_point_array(Way_LatLon_of_Nodes[i], way_points);
+        Way_WayLength[i].push_back(polyline_length(way_points));
     }
 }
 
-//Get Node By ID
+//Get Node By ID, nullptr if the node is not in the map
 const OSMNode* getNodeById(const OSMID& nodeId) {
-    auto it = std::find(NodeIndex_OSMId.begin(), NodeIndex_OSMId.end(), nodeId);
-    return NodeIndex_NodeId[std::distance(NodeIndex_OSMId.begin(), it)];
+    int index = find_osmid_index(node_osmid_index, nodeId);
+    return (index == -1) ? nullptr : NodeIndex_NodeId[index];
 }
 
-//Get Way By ID
+//Get Way By ID, nullptr if the way is not in the map
 const OSMWay* getWayById(const OSMID& wayId) {
-    auto it = std::find(WayIndex_OSMId.begin(), WayIndex_OSMId.end(), wayId);
-    return WayIndex_WayId[std::distance(WayIndex_OSMId.begin(), it)];
+    int index = find_osmid_index(way_osmid_index, wayId);
+    return (index == -1) ? nullptr : WayIndex_WayId[index];
+}
+
+//Get Relation By ID, nullptr if the relation is not in the map
+const OSMRelation* getRelationById(const OSMID& relationId) {
+    int index = find_osmid_index(relation_osmid_index, relationId);
+    return (index == -1) ? nullptr : RelationIndex_RelationId[index];
 }
 
 
@@ -1006,30 +841,22 @@ const OSMWay* getWayById(const OSMID& wayId) {
 // Speed Requirement --> none 
 //COMPLETED
 POIIdx findClosestPOI(LatLon my_position, std::string poi_name) {
-    int Num_POI = getNumPointsOfInterest();
-    std::vector<POIIdx> TargetPOIs;
-
-    /// Loop Through All POIs
-    for (POIIdx POI = 0; POI < Num_POI; ++POI) {
-        std::string name = getPOIName(POI);
-
-        if (name == poi_name) {
-            TargetPOIs.push_back(POI);
-        }
-    }
+    // distances to all POIs are computed in batches, and a name is only compared
+    // when that POI is closer than the best match so far
+    const int block = 1024;
+    double distances[block];
 
-    // Initialize with a large distance
     double SmallestDistance = std::numeric_limits<double>::infinity();
-    POIIdx ClosestPOI = TargetPOIs[0];
-
-    // Loop through all Target POI Positions to find their distance from MyLocation
-    for (int i = 0; i < TargetPOIs.size(); ++i) {
-        LatLon Position_Of_POI = getPOIPosition(TargetPOIs[i]);
-        double Distance_Between_Me_And_Target = findDistanceBetweenTwoPoints(Position_Of_POI, my_position);
-
-        if (Distance_Between_Me_And_Target < SmallestDistance) {
-            SmallestDistance = Distance_Between_Me_And_Target;
-            ClosestPOI = TargetPOIs[i];
+    POIIdx ClosestPOI = -1;
+    for (int first = 0; first < getNumPointsOfInterest(); first += block) {
+        int count = std::min(block, getNumPointsOfInterest() - first);
+        distances_from_point(my_position, poi_points, first, count, distances);
+
+        for (int i = 0; i < count; ++i) {
+            if (distances[i] < SmallestDistance && getPOIName(first + i) == poi_name) {
+                SmallestDistance = distances[i];
+                ClosestPOI = first + i;
+            }
         }
     }
 
@@ -1040,92 +867,10 @@ POIIdx findClosestPOI(LatLon my_position, std::string poi_name) {
 // Assume a non self-intersecting polygon (i.e. no holes).
 // Return 0 if this feature is not a closed polygon
 // Speed Requirement --> moderate
-// HELPER FUNCTIONS
-double x_featureCoordinate (LatLon featurePoint, double lat_avg) {
-    // used to convert x coordinates
-    // covert longitude to radians
-    double featurePoint_long = featurePoint.longitude() * kDegreeToRadian;
-
-    // convert feature point to x coordinate
-    double featurePoint_x = kEarthRadiusInMeters*featurePoint_long*cos(lat_avg);
-    return featurePoint_x;
-}
-
-double y_featureCoordinate (LatLon featurePoint) {
-    // used to convert y coordinates
-    // covert latitude to radians
-    double featurePoint_lat = featurePoint.latitude() * kDegreeToRadian;
-
-    // convert feature point to x coordinate
-    double featurePoint_y = kEarthRadiusInMeters * featurePoint_lat;
-    return featurePoint_y;
-}
-
-double computeFeatureArea (std::vector <double> x_coord, std:: vector <double> y_coord, int numCoords) {
-    // used to compute the area of a polygon
-
-    // variable used to store returning area and store crossProduct sum
-    double featureArea = 0.0;
-    double sumCrossP = 0.0;
-
-    // loop through all coordinate pairs
-    for (int i = 0; i < numCoords;i++) {
-        // when i reaches last element, should crossProduct with the first elements
-        if (i == numCoords-1) {
-            sumCrossP += (x_coord[i] * y_coord[0]) - (y_coord[i] * x_coord[0]);
-        } else {
-            // compute cross product at i
-            sumCrossP += (x_coord[i] * y_coord[i+1]) - (y_coord[i] * x_coord[i+1]);
-        }
-    }
-
-    // compute the area
-    featureArea = std::abs(sumCrossP)/2.0;
-    return featureArea;
-}
+// COMPLETED
 double findFeatureArea(FeatureIdx feature_id) {
-    // get the number of feature points
-    int numFeaturePoints = getNumFeaturePoints (feature_id);
-
-    // intialize vectors to store feature points and xy coords
-    std:: vector <LatLon> allFeaturePoints(numFeaturePoints);
-    std:: vector <double> all_x_featurePoints (numFeaturePoints);
-    std:: vector <double> all_y_featurePoints (numFeaturePoints);
-
-    // initialize variable to store final value
-    double totalFeatureArea = 0.0;
-
-    // when closed polygon: loop through all feature points and store LatLons
-    for (int i = 0; i< numFeaturePoints; i++) {
-        allFeaturePoints[i] = getFeaturePoint(i, feature_id);
-    }
-
-     // when the starting point is endpoint for closed polygon
-     // or num points < 3 is also not a polygon
-    if (((allFeaturePoints[0].latitude() != allFeaturePoints[numFeaturePoints-1].latitude()) &&
-        (allFeaturePoints[0].longitude() != allFeaturePoints[numFeaturePoints-1].longitude()) )|| numFeaturePoints < 3) {
-        return totalFeatureArea;
-    }
-
-    // compute the average latitude
-    double lat_avg = 0.0;
-    double lat_total = 0.0;
-    for (int k = 0; k < numFeaturePoints; k++) {
-        lat_total += allFeaturePoints[k].latitude() * kDegreeToRadian;
-    }
-
-    lat_avg = lat_total / numFeaturePoints;
-
-    // convert LatLons to xy coords
-    for (int j = 0; j < numFeaturePoints; j++) {
-        all_x_featurePoints[j] = x_featureCoordinate(allFeaturePoints[j], lat_avg);
-        all_y_featurePoints[j] = y_featureCoordinate(allFeaturePoints[j]);
-
-    }
-    // compute total feature area
-    totalFeatureArea = computeFeatureArea (all_x_featurePoints, all_y_featurePoints, numFeaturePoints);
-
-    return totalFeatureArea;
+    // computed for every feature in load_feature_metadata
+    return feature_metadata.area[feature_id];
 }
 
 // Returns the length of the OSMWay that has the given OSMID, in meters.
@@ -1135,19 +880,10 @@ double findFeatureArea(FeatureIdx feature_id) {
 //COMPLETED
 double findWayLength(OSMID way_id) {
 
-    //Get Way Index by way OSMID
-    //Fetch From Database Loaded in Loadmap
-    const OSMWay* OSMWay_ID =getWayById(way_id);
-
-    //get Way Index using OSMWay*
-    //return Way_WayLength[way index];
-    for (int i = 0; i < getNumberOfWays(); ++i) {
-        const OSMWay* way = getWayByIndex(i);
-
-        if (way==OSMWay_ID){
-            return Way_WayLength[i][0];
-            break;
-        }
+    //Get Way Index by way OSMID from the hash built in loadMap
+    int way_index = find_osmid_index(way_osmid_index, way_id);
+    if (way_index != -1) {
+        return Way_WayLength[way_index][0];
     }
     return 0.0;
 }
@@ -1159,260 +895,117 @@ double findWayLength(OSMID way_id) {
 
 // helper function that finds the OSMNode of the id
 const OSMNode* matchingNodesForOSMID (OSMID osm_id) {
-    int numberOfOSMNodes = getNumberOfNodes();
-
-    for (int i = 0; i < numberOfOSMNodes; ++i) {
-        const OSMNode *nodeAtIndex = getNodeByIndex(i);
-        // compare to see if the id is the osm_id
-        if (nodeAtIndex->id() == osm_id) {
-            // the id is found
-            return nodeAtIndex;
-        }
-    }
-    // id not found
-    return nullptr;
+    // nullptr when the id is not found
+    return getNodeById(osm_id);
 }
 
 std::string getOSMNodeTagValue(OSMID osm_id, std::string key){
-    // call helper function for getting node
-    const OSMNode* nodeAtID = matchingNodesForOSMID(osm_id);
+    // node index from the OSMID hash
+    int node = find_osmid_index(node_osmid_index, osm_id);
 
     // node not found
-    if (nodeAtID == nullptr) {
+    if (node == -1) {
         return " ";
     }
 
-    int numOfTags = getTagCount(nodeAtID);
-
-    // for loop to loop through all nodes to find the Node OSMID corresponding to the osm_id
-    for (int i = 0; i < numOfTags; ++ i) {
-        std:: pair<std::string, std::string> tagPairAtId = getTagPair(nodeAtID, i);
-        // compare to see of key is same
-        if (tagPairAtId.first == key) {
-            // when key is the same, return the value
-            return tagPairAtId.second;
-        }
-    }
+    // binary search for the key among the node's tags
+    int value = find_osm_tag(node_tags, node, find_osm_string(key));
 
     // if the tag is not found, return empty string
-    return " ";
+    if (value == -1) {
+        return " ";
+    }
+    return osm_string(value);
 }
 
 //Helper functions in m2.cpp
-//initialize all feature vectors here
-void initial_parks(){
-    for (int i = 0; i < getNumFeatures(); ++i) {
-        if (getFeatureType(i) == PARK) {
-            parks.push_back(i);
-        }
+//group the features by FeatureType with one counting sort, row t of feature_buckets
+//holds the features of type t ordered by draw_size (largest first)
+void load_feature_buckets() {
+    int numFeatures = getNumFeatures();
+    int numTypes = GLACIER + 1;
+
+    std::vector<int> types(numFeatures);
+    feature_buckets.offsets.assign(numTypes + 1, 0);
+    for (int i = 0; i < numFeatures; ++i) {
+        types[i] = getFeatureType(i);
+        feature_buckets.offsets[types[i] + 1]++;
     }
-}
-
-void initial_lakes() {
-    for (int i = 0; i < getNumFeatures(); ++i) {
-        if (getFeatureType(i) == LAKE) {
-            lakes.push_back(i);
-        }
+    for (int t = 0; t < numTypes; ++t) {
+        feature_buckets.offsets[t + 1] += feature_buckets.offsets[t];
     }
-}
 
-void initial_rivers() {
-    for (int i = 0; i < getNumFeatures(); ++i) {
-        if (getFeatureType(i) == RIVER) {
-            rivers.push_back(i);
-        }
+    std::vector<int> next(feature_buckets.offsets.begin(), feature_buckets.offsets.end() - 1);
+    feature_buckets.values.resize(numFeatures);
+    for (int i = 0; i < numFeatures; ++i) {
+        feature_buckets.values[next[types[i]]++] = i;
     }
-}
 
-void initial_beaches() {
-    for (int i = 0; i < getNumFeatures(); ++i) {
-        if (getFeatureType(i) == BEACH) {
-            beaches.push_back(i);
-        }
-    }
-}
-void initial_islands() {
-    for (int i = 0; i < getNumFeatures(); ++i) {
-        if (getFeatureType(i) == ISLAND) {
-            islands.push_back(i);
-        }
-    }
-}
-void initial_buildings() {
-    for (int i = 0; i < getNumFeatures(); ++i) {
-        if (getFeatureType(i) == BUILDING) {
-            buildings.push_back(i);
-        }
-    }
-}
-void initial_greenspaces() {
-    for (int i = 0; i < getNumFeatures(); ++i) {
-        if (getFeatureType(i) == GREENSPACE) {
-            greenspaces.push_back(i);
-        }
-    }
-}
-void initial_golfcourses() {
-    for (int i = 0; i < getNumFeatures(); ++i) {
-        if (getFeatureType(i) == GOLFCOURSE) {
-            golfcourses.push_back(i);
-        }
-    }
-}
-void initial_streams() {
-    for (int i = 0; i < getNumFeatures(); ++i) {
-        if (getFeatureType(i) == STREAM) {
-            streams.push_back(i);
-        }
-    }
-}
-void initial_glaciers() {
-    for (int i = 0; i < getNumFeatures(); ++i) {
-        if (getFeatureType(i) == GLACIER) {
-            glaciers.push_back(i);
-        }
+    //stable so features of the same size keep the database order
+    #pragma omp parallel for schedule(dynamic, 1)
+    for (int t = 0; t < numTypes; ++t) {
+        std::stable_sort(feature_buckets.values.begin() + feature_buckets.offsets[t],
+                         feature_buckets.values.begin() + feature_buckets.offsets[t + 1],
+                         [](FeatureIdx lhs, FeatureIdx rhs) {
+                             return feature_metadata.draw_size[lhs] > feature_metadata.draw_size[rhs];
+                         });
     }
 }
 
 //initialize all vectors related to OSM_Database here
-// subways
-void SUBWAY_OSM_Database() {
-    //initial the size
-    for (int i = 0; i < getNumberOfNodes(); ++i){
-        const OSMNode* n = getNodeByIndex(i);
-        int tag_count = getTagCount(n);
-
-        for (int j = 0; j < tag_count; j++ ) {
-            if (!((getTagPair(n, j).first == "station")&&(getTagPair(n, j).second == "subway"))){
-                continue;
-            }
+// every layer is a tag query, all of them are answered by one pass over the OSM database
+void load_osm_layers() {
+    osm_layer_queries[SUBWAY_STATION_LAYER] = register_osm_tag_query(OSM_NODE, "station", "subway");
+    osm_layer_queries[TOILET_LAYER] = register_osm_tag_query(OSM_NODE, "toilets", "yes");
+    osm_layer_queries[TOILET_WHEELCHAIR_LAYER] = register_osm_tag_query(OSM_NODE, "toilets:wheelchair", "yes");
+    osm_layer_queries[SUBWAY_RAIL_LAYER] = register_osm_tag_query(OSM_WAY, "railway", "subway");
+    run_osm_tag_queries();
 
-            subway_stations.push_back( getNodeCoords(n));
-            break;
-        }
-    }
+    SUBWAY_OSM_Database();
+    toilet_OSM_Database();
+    toilets_wheelchair_OSM_Database();
 }
-// public washrooms
-void toilet_OSM_Database() {
-    //initial the size
-    for (int i = 0; i < getNumberOfNodes(); ++i){
-        const OSMNode* n = getNodeByIndex(i);
-        int tag_count = getTagCount(n);
-
-        for (int j = 0; j < tag_count; j++ ) {
-            if (!((getTagPair(n, j).first == "toilets")&&(getTagPair(n, j).second == "yes"))){
-                continue;
-            }
-
-            std::pair<LatLon, std::string> toilet_location_name;
-            toilet_location_name.first = getNodeCoords(n);
-
-            for (int k=0; k<tag_count; k++){
-                if (getTagPair(n,k).first=="name"){
-
-                    toilet_location_name.second = getTagPair(n,k).second;
-                }
-            }
 
-            toilets.push_back(toilet_location_name);
-        }
-    }
+// the OSM entities of a layer, in database order
+const std::vector<int>& osm_layer_matches(OSMLayer layer) {
+    return osm_tag_queries[osm_layer_queries[layer]].matches;
 }
-//accessibility washrooms
-void toilets_wheelchair_OSM_Database() {
-    //initial the size
-    for (int i = 0; i < getNumberOfNodes(); ++i){
-        const OSMNode* n = getNodeByIndex(i);
-        int tag_count = getTagCount(n);
-
-        for (int j = 0; j < tag_count; j++ ) {
-            if (!((getTagPair(n, j).first == "toilets:wheelchair")&&(getTagPair(n, j).second == "yes"))){
-                continue;
-            }
 
-            std::pair<LatLon, std::string> toilet_wheelchair_location_name;
-            toilet_wheelchair_location_name.first = getNodeCoords(n);
-
-            for (int k=0; k<tag_count; k++){
-                if (getTagPair(n,k).first=="name"){
-
-                    toilet_wheelchair_location_name.second = getTagPair(n,k).second;
-                }
-            }
+// subways
+void SUBWAY_OSM_Database() {
+    const std::vector<int>& stations = osm_layer_matches(SUBWAY_STATION_LAYER);
+    subway_stations.reserve(stations.size());
 
-            toilets_wheelchair.push_back(toilet_wheelchair_location_name);
-        }
+    for (int i = 0; i < stations.size(); ++i){
+        subway_stations.push_back(getNodeCoords(getNodeByIndex(stations[i])));
     }
 }
 
-//initial the subway route
-void init_subway_route() {
-    int numberOfOSMWays = getNumberOfWays();
-    subway_nodes.resize(numberOfOSMWays);
-
-    for (int i = 0; i < numberOfOSMWays; ++i) {
-
-        for (int j = 0; j < getTagCount(getWayByIndex(i)); j++) {
-            if ((getTagPair(getWayByIndex(i), j).first == "railway") &&
-                (getTagPair(getWayByIndex(i), j).second == "subway")) {
-                for (int k = 0; k < Way_LatLon_of_Nodes[i].size() - 1; ++k) {
+// the location and name of every node in the layer
+static void load_named_locations(const std::vector<int>& layer, std::vector<std::pair<LatLon, std::string>>& locations) {
+    int name = find_osm_string("name");
+    locations.reserve(layer.size());
 
-                    //Way_LatLon_of_Nodes[i] = vector <nodes>
-                    LatLon LocationOfNode1 = Way_LatLon_of_Nodes[i][k];
-                    LatLon LocationOfNode2 = Way_LatLon_of_Nodes[i][k + 1];
+    for (int i = 0; i < layer.size(); ++i){
+        std::pair<LatLon, std::string> location_name;
+        location_name.first = getNodeCoords(getNodeByIndex(layer[i]));
 
-                    std::pair<LatLon, LatLon> subway_segment;
-                    subway_segment.first = LocationOfNode1;
-                    subway_segment.second = LocationOfNode2;
-                    subway_nodes.push_back(subway_segment);
-
-                }
-            }
-
-
-            if ((getTagPair(getWayByIndex(i), j).first == "highway")){
-
-                if(getTagPair(getWayByIndex(i), j).second == "secondary"){
-                    for (int k = 0; k < Way_LatLon_of_Nodes[i].size() - 1; ++k) {
-
-                        //Way_LatLon_of_Nodes[i] = vector <nodes>
-                        LatLon LocationOfNode1 = Way_LatLon_of_Nodes[i][k];
-                        LatLon LocationOfNode2 = Way_LatLon_of_Nodes[i][k + 1];
-
-                        std::pair<LatLon, LatLon> highway_segment;
-                        highway_segment.first = LocationOfNode1;
-                        highway_segment.second = LocationOfNode2;
-                        secondary_highway_nodes.push_back(highway_segment);
-
-                    }
-
-                }
-
-
-                if(getTagPair(getWayByIndex(i), j).second == "tertiary"){
-                    for (int k = 0; k < Way_LatLon_of_Nodes[i].size() - 1; ++k) {
-
-                        //Way_LatLon_of_Nodes[i] = vector <nodes>
-                        LatLon LocationOfNode1 = Way_LatLon_of_Nodes[i][k];
-                        LatLon LocationOfNode2 = Way_LatLon_of_Nodes[i][k + 1];
-
-                        std::pair<LatLon, LatLon> highway_segment;
-                        highway_segment.first = LocationOfNode1;
-                        highway_segment.second = LocationOfNode2;
-                        tertiary_highway_nodes.push_back(highway_segment);
-
-                    }
-
-                }
-
-
-
-            }
+        int name_value = find_osm_tag(node_tags, layer[i], name);
+        if (name_value != -1) {
+            location_name.second = osm_string(name_value);
         }
+
+        locations.push_back(location_name);
     }
+}
 
-//    getTagPair(getWayByIndex(i), j).second == "primary_link" || getTagPair(getWayByIndex(i), j).second == "trunk_link"
-//    || getTagPair(getWayByIndex(i), j).second == "secondary"||  getTagPair(getWayByIndex(i), j).second == "secondary_link"
+// public washrooms
+void toilet_OSM_Database() {
+    load_named_locations(osm_layer_matches(TOILET_LAYER), toilets);
+}
+//accessibility washrooms
+void toilets_wheelchair_OSM_Database() {
+    load_named_locations(osm_layer_matches(TOILET_WHEELCHAIR_LAYER), toilets_wheelchair);
 }
 
 // different load map databases
@@ -1449,20 +1042,6 @@ void initial_intersections() {
     }
 }
 
-//load all icons used in the map
-void load_subway_png() {
-    surface_subway = icon_g->load_png("libstreetmap/resources/subway_station.png");
-}
-void load_toilet_png() {
-    surface_toilet = icon_g->load_png("libstreetmap/resources/toilet.png");
-}
-void load_toilet_wheelchair_png() {
-    surface_toilet_wheelchair = icon_g->load_png("libstreetmap/resources/toilet_wheelchair.png");
-}
-void load_location_png() {
-    surface_location = icon_g->load_png("libstreetmap/resources/location.png");
-}
-
 // calculate maxLon and maxLat of world
 void load_max_min_lat_lon(){
     max_lat = getIntersectionPosition(0).latitude();
@@ -1478,50 +1057,37 @@ void load_max_min_lat_lon(){
         min_lon = std::min(min_lon, getIntersectionPosition(id).longitude());
     }
     avg_lat = (max_lat+min_lat)/2;
+    load_map_projection();
 }
 
 //initial the vector for compute the path travel time
 //<streetID, time> for each street segment
 void load_segment_time(){
+    segment_time.reserve(getNumStreetSegments());
     for (int i=0; i<getNumStreetSegments(); ++i){
-        double time = findStreetSegmentLength(i)/getStreetSegmentInfo(i).speedLimit;
-
-        StreetIdx street = getStreetSegmentInfo(i).streetID;
-        segment_time.push_back(std::make_pair(street, time));
-
+        segment_time.push_back(std::make_pair(segment_geometry.street_id[i], segment_geometry.travel_time[i]));
     }
 }
 
 //Below is the help functions for m3.cpp
-void initial_segment_highlighted(){
-
-    for(int i=0; i<getNumStreetSegments(); ++i){
-        segment_highlighted.push_back(false);
-    }
-
-    for(int i=0; i<getNumStreetSegments(); ++i){
-        explore_highlighted.push_back(false);
-    }
-}
-
-
 void init_nodes(){
 
     std::vector<Node> ().swap(Nodes);
     for(int i=0; i<getNumIntersections(); ++i){
         Node node;
         node.visited= false;
-        for(int j=0; j<getNumIntersectionStreetSegment(i); ++j){
-            StreetSegmentIdx seg = getIntersectionStreetSegment(j,i);
-            IntersectionIdx from = getStreetSegmentInfo(seg).from;
-            IntersectionIdx to = getStreetSegmentInfo(seg).to;
+        // the segments of the intersection are walked in place, from the CSR table loaded in loadMap
+        for(StreetSegmentIdx seg : street_segments_of_intersection(i)){
+            StreetSegmentInfo info = getStreetSegmentInfo(seg);
+            IntersectionIdx from = info.from;
+            IntersectionIdx to = info.to;
             int to_node;
             std::pair<StreetSegmentIdx, int> out_edge_to_node;
             if (i==from){
                 to_node = to;
             }else{
                 //if is One way street, we don't consider this path
-                if(getStreetSegmentInfo(seg).oneWay){
+                if(info.oneWay){
                     continue;
                 }
                 to_node = from;
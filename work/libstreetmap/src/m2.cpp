@@ -25,22 +25,18 @@ int total_distance;
 int total_time;
 
 std::vector<IntersectionIdx> highlighted;
-std::vector<bool> segment_highlighted;
 std::vector<StreetSegmentIdx> popped;
-std::vector<bool> explore_highlighted;
 std::vector<std::pair<StreetIdx, double >> Path_street_length;
 std::vector<std::string> turn_to;
-std::vector<std::pair<LatLon, LatLon>> tertiary_highway_nodes;
-std::vector<std::pair<LatLon, LatLon>> secondary_highway_nodes;
-std::vector<std::pair<LatLon, LatLon>> primary_highway_nodes;
-std::vector<std::pair<LatLon, LatLon>> quaternary_highway_nodes;
-std::vector<std::pair<LatLon, LatLon>> primary_link_nodes;
 std::vector<int> path_length;
 
 // big scope variables in program
 
 bool pinkify = false;
 bool subway_show = false;
+bool parallel_render = true; //draw the map base in strips on the tile workers when it is not drawn from tiles
+ezgl::canvas* main_canvas = nullptr;
+thread_local MapStyle map_style; //set by every thread before it draws
 bool find_path_pressed = false;
 
 // main draw map call return to main
@@ -59,259 +55,248 @@ void drawMap() {
 
 
 //Converting Lat/Lon to Cartesian X/Y
+//the constants are cached in map_projection when the map is loaded
 float x_from_lon(float lon) {
-    return (lon * kDegreeToRadian * kEarthRadiusInMeters * std::cos(avg_lat * kDegreeToRadian));
+    return lon * map_projection.x_per_degree;
 }
 
 float y_from_lat(float lat) {
-    return kEarthRadiusInMeters * lat * kDegreeToRadian;
+    return lat * map_projection.y_per_degree;
 }
 
 // converting X/Y from Lat/Lon
 float lon_from_x(float x) {
-    return (x/(kDegreeToRadian * kEarthRadiusInMeters * std::cos(avg_lat * kDegreeToRadian)));
+    return x / map_projection.x_per_degree;
 }
 
 float lat_from_y(float y) {
-    return (y/(kEarthRadiusInMeters * kDegreeToRadian));
+    return y / map_projection.y_per_degree;
 }
 
 
 //draw all features here, classify closed polygon, line and point
-void draw_features( std::vector<FeatureIdx> FeatureName, ezgl:: renderer *g){
+//FeatureName is a row of visible_features, already limited to the grid cells on screen
+//culling and level of detail use the feature metadata computed in loadMap
+//the features are recorded in the render queue with the style set by the draw_* function of their type
+void draw_features(IndexSpan<FeatureIdx> FeatureName, ezgl:: renderer *g){
+
+    const ezgl::rectangle visible_world = g->get_visible_world();
+    //the outlines of features just off a tile still reach into it, see draw_map_tile
+    const ezgl::rectangle cull_world = g->get_cull_world();
+    const ezgl::point2d top_right(cull_world.top_right());
+    const ezgl::point2d bottom_left(cull_world.bottom_left());
+
+    //features smaller than a pixel on screen are not drawn, the rows are sorted
+    //by draw_size so every feature after the first one that small is smaller too
+    const double world_per_pixel = visible_world.width() / g->get_visible_screen().width();
+    const double pixel_area = world_per_pixel * world_per_pixel;
+
+    //reused between features and frames so no polygon is allocated while drawing
+    //(one per thread, tiles are drawn by the tile workers)
+    static thread_local std::vector<ezgl::point2d> polygon;
 
-    const ezgl::point2d top_right(g->get_visible_world().top_right());
-    const ezgl::point2d bottom_left(g->get_visible_world().bottom_left());
-
-
-//    std::cout<<bottom_left.x<<" "<<bottom_left.y<<std::endl;
-//    std::cout<<top_right.x<<" "<<top_right.y<<std::endl;
-
-
-    //Closed Polygon
     for(int i=0; i < FeatureName.size(); ++i){
-        std::vector<ezgl::point2d> polygon;
-        bool poly_in_world = false;
-        //Each feature
-        for (int j=0; j<getNumFeaturePoints(FeatureName[i]); ++j){
-            //Each feature in the Lake Vector
-            LatLon pos = getFeaturePoint(j,FeatureName[i]);
-            ezgl::point2d xy_pos= {x_from_lon(pos.longitude()), y_from_lat(pos.latitude())};
-
-
-            if (( (xy_pos.x>bottom_left.x) && (xy_pos.x<top_right.x) && (xy_pos.y>bottom_left.y) && (xy_pos.y<top_right.y) )){
-                poly_in_world = true;
-            }
-
+        FeatureIdx id = FeatureName[i];
+        if (feature_metadata.draw_size[id] < pixel_area) {
+            break;
+        }
 
-            polygon.push_back(xy_pos);
+        //bounding box outside of the visible world
+        if (feature_metadata.max_x[id] < bottom_left.x || feature_metadata.min_x[id] > top_right.x ||
+            feature_metadata.max_y[id] < bottom_left.y || feature_metadata.min_y[id] > top_right.y) {
+            continue;
         }
 
-        if(polygon.size()<=1){
-            g->fill_rectangle(polygon[0], 5, 5);
+        //Point Feature
+        if(feature_metadata.num_points[id] <= 1){
+            queue_rectangle({feature_metadata.centroid_x[id], feature_metadata.centroid_y[id]}, 5, 5);
             continue;
-            //Size !> 1
         }
 
-        if(polygon[0] != polygon[polygon.size()-1]){
-            g->draw_line(polygon[0], polygon[1]);
+        //Each feature, read from the points projected in loadMap at the level of detail of this frame
+        get_projected_row(lod_polylines(feature_lod, feature_xy), id, polygon);
+        if (polygon.empty()) {
             continue;
-            //Not closed - Line Feature
+            //Dropped at this level
         }
 
-        if(!poly_in_world){
+        //Not closed - Line Feature
+        if(!feature_metadata.closed[id]){
+            polygon.resize(2);
+            queue_lines(polygon);
             continue;
         }
 
-        g->fill_poly(polygon);
+        //Closed Polygon
+        queue_polygon(polygon);
     }
 
 }
 
 
+//open features keep the width of the map border drawn before them
+#define FEATURE_LINE_WIDTH 10
+
 //set the color of each feature, including day_mode and dark_mode, then draw
 void draw_parks(ezgl:: renderer *g){
-    if (!pinkify) {
-        g->set_color(128, 210, 128);
+    if (!map_style.pinkify) {
+        queue_style(PARK_DRAW_LAYER, ezgl::color(128, 210, 128), FEATURE_LINE_WIDTH);
     }
-    if (pinkify) {
-        g->set_color(63, 100, 67);
+    if (map_style.pinkify) {
+        queue_style(PARK_DRAW_LAYER, ezgl::color(63, 100, 67), FEATURE_LINE_WIDTH);
     }
-    draw_features(parks, g);
+    draw_features(visible_features[PARK], g);
 }
 
 void draw_lakes(ezgl:: renderer *g){
-    if (!pinkify) {
-        g->set_color(143,190,209);
+    if (!map_style.pinkify) {
+        queue_style(LAKE_DRAW_LAYER, ezgl::color(143,190,209), FEATURE_LINE_WIDTH);
     }
-    if (pinkify) {
-        g->set_color(ezgl::BLACK);
+    if (map_style.pinkify) {
+        queue_style(LAKE_DRAW_LAYER, ezgl::BLACK, FEATURE_LINE_WIDTH);
     }
-    draw_features(lakes, g);
+    draw_features(visible_features[LAKE], g);
 }
 
 void draw_rivers(ezgl:: renderer *g){
-    if (!pinkify) {
-        g->set_color(ezgl::LIGHT_SKY_BLUE);
+    if (!map_style.pinkify) {
+        queue_style(RIVER_DRAW_LAYER, ezgl::LIGHT_SKY_BLUE, FEATURE_LINE_WIDTH);
     }
-    if (pinkify) {
-        g->set_color(47, 69, 74);
+    if (map_style.pinkify) {
+        queue_style(RIVER_DRAW_LAYER, ezgl::color(47, 69, 74), FEATURE_LINE_WIDTH);
     }
-    draw_features(rivers, g);
+    draw_features(visible_features[RIVER], g);
 }
 
 void draw_beaches(ezgl:: renderer *g) {
-    if (!pinkify) {
-        g->set_color(235, 200, 130);
+    if (!map_style.pinkify) {
+        queue_style(BEACH_DRAW_LAYER, ezgl::color(235, 200, 130), FEATURE_LINE_WIDTH);
     }
-    if (pinkify) {
-        g->set_color(87, 77, 54);
+    if (map_style.pinkify) {
+        queue_style(BEACH_DRAW_LAYER, ezgl::color(87, 77, 54), FEATURE_LINE_WIDTH);
     }
-    draw_features(beaches, g);
+    draw_features(visible_features[BEACH], g);
 }
 
 void draw_islands(ezgl:: renderer *g){
-    if (!pinkify) {
-        g->set_color(123, 205, 123);
+    if (!map_style.pinkify) {
+        queue_style(ISLAND_DRAW_LAYER, ezgl::color(123, 205, 123), FEATURE_LINE_WIDTH);
     }
-    if (pinkify) {
-        g->set_color(63, 100, 67);
+    if (map_style.pinkify) {
+        queue_style(ISLAND_DRAW_LAYER, ezgl::color(63, 100, 67), FEATURE_LINE_WIDTH);
     }
-    draw_features(islands, g);
+    draw_features(visible_features[ISLAND], g);
 }
 
 void draw_buildings(ezgl:: renderer *g){
-    if (!pinkify) {
-        g->set_color(190,190, 166);
+    if (!map_style.pinkify) {
+        queue_style(BUILDING_DRAW_LAYER, ezgl::color(190,190, 166), FEATURE_LINE_WIDTH);
     }
-    if (pinkify) {
-        g->set_color(61,48,49);
+    if (map_style.pinkify) {
+        queue_style(BUILDING_DRAW_LAYER, ezgl::color(61,48,49), FEATURE_LINE_WIDTH);
     }
-    draw_features(buildings, g);
+    draw_features(visible_features[BUILDING], g);
 }
 
 void draw_greenspaces(ezgl:: renderer *g){
-    if (!pinkify) {
-        g->set_color(120, 210, 120);
+    if (!map_style.pinkify) {
+        queue_style(GREENSPACE_DRAW_LAYER, ezgl::color(120, 210, 120), FEATURE_LINE_WIDTH);
     }
-    if (pinkify) {
-        g->set_color(73, 100, 77);
+    if (map_style.pinkify) {
+        queue_style(GREENSPACE_DRAW_LAYER, ezgl::color(73, 100, 77), FEATURE_LINE_WIDTH);
     }
-    draw_features(greenspaces, g);
+    draw_features(visible_features[GREENSPACE], g);
 }
 
 void draw_golfcourses(ezgl:: renderer *g){
-    if (!pinkify) {
-        g->set_color(ezgl::GREY_75);
+    if (!map_style.pinkify) {
+        queue_style(GOLFCOURSE_DRAW_LAYER, ezgl::GREY_75, FEATURE_LINE_WIDTH);
     }
-    if (pinkify) {
-        g->set_color(56, 60, 64);
+    if (map_style.pinkify) {
+        queue_style(GOLFCOURSE_DRAW_LAYER, ezgl::color(56, 60, 64), FEATURE_LINE_WIDTH);
     }
-    draw_features(golfcourses, g);
+    draw_features(visible_features[GOLFCOURSE], g);
 }
 void draw_glaciers(ezgl:: renderer *g){
-    if (!pinkify) {
-        g->set_color(ezgl::BLUE);
+    if (!map_style.pinkify) {
+        queue_style(GLACIER_DRAW_LAYER, ezgl::BLUE, FEATURE_LINE_WIDTH);
     }
-    if (pinkify) {
-        g->set_color(ezgl::BLACK);
+    if (map_style.pinkify) {
+        queue_style(GLACIER_DRAW_LAYER, ezgl::BLACK, FEATURE_LINE_WIDTH);
     }
-    draw_features(glaciers, g);
+    draw_features(visible_features[GLACIER], g);
 }
 
 void draw_streams(ezgl:: renderer *g){
-    if (!pinkify) {
-        g->set_color(135,206,250);
+    if (!map_style.pinkify) {
+        queue_style(STREAM_DRAW_LAYER, ezgl::color(135,206,250), FEATURE_LINE_WIDTH);
     }
-    if (pinkify) {
-        g->set_color(ezgl::BLACK);
+    if (map_style.pinkify) {
+        queue_style(STREAM_DRAW_LAYER, ezgl::BLACK, FEATURE_LINE_WIDTH);
     }
-    draw_features(streams, g);
+    draw_features(visible_features[STREAM], g);
 }
 
-//draw all intersections in the map
+//draw the highlighted intersections with the location icon and their name
+//from the list of highlighted ones, part of the route overlay
 void draw_intersections (ezgl:: renderer *g){
 
-    //get all the intersections
-    for (size_t i = 0; i < intersections.size(); ++i){
-
-        float x = x_from_lon(intersections[i].position.longitude());
-        float y = y_from_lat(intersections[i].position.latitude());
+    g->set_font_size(POI_LABEL_FONT_SIZE);
+    g->set_color(pinkify ? ezgl::WHITE : ezgl::BLACK);
 
-        // if highlighted, show the location icon
-        if(intersections[i].highlight){
-            g ->draw_surface(surface_location,{x,y}, 0.065);
+    for (IntersectionIdx i : highlighted){
 
-            if (!pinkify) {
-                g->set_color(ezgl::BLACK);
-            }
-            if (pinkify){
-                g -> set_color (ezgl::WHITE);
-            }
-
-            std::string name = intersections[i].name;
-            size_t pos = name.find("<unknown>");
+        // clicking a highlighted intersection again turns it off but keeps it in the list
+        if(!intersections[i].highlight){
+            continue;
+        }
 
-            if(pos == -1){
+        double x = intersection_xy.x[i];
+        double y = intersection_xy.y[i];
+        draw_icon(g, LOCATION_ICON, {x,y});
 
-                g->draw_text({x, y}, name, 100000, 1000000);
-                continue;
-            }
+        std::string name = intersections[i].name;
+        size_t pos = name.find("<unknown>");
 
+        if(pos != -1){
             name.replace(pos,name.size(),"Location");
-            g->draw_text({x, y}, name, 100000, 1000000);
         }
-
+        g->draw_text({x, y}, name, 100000, 1000000);
     }
 }
 
 //draw all the vector related to the OSM Database
+//the icons come from the icon atlas, the ones off screen or overlapping an icon already drawn are skipped
 void draw_subway_station(ezgl:: renderer *g){
-    for(int i = 0; i < subway_stations.size(); ++i) {
-        double x = x_from_lon(subway_stations[i].longitude());
-        double y = y_from_lat(subway_stations[i].latitude());
-        g ->draw_surface(surface_subway,{x,y}, 0.065);
-    }
+    draw_icon_layer(g, subway_icons);
 }
 void draw_toilet (ezgl::renderer* g){
-    for(int i = 0; i < toilets.size(); ++i) {
-        double x = x_from_lon(toilets[i].first.longitude());
-        double y = y_from_lat(toilets[i].first.latitude());
-        g ->draw_surface(surface_toilet,{x,y}, 0.061);
-//        if (scale >1.435)
-        g->set_color(ezgl::BLACK);
-        g->set_font_size(12);
-    }
+    draw_icon_layer(g, toilet_icons);
 }
 
 
-void draw_toilet_label (ezgl::renderer* g) {
-    for (int i = 0; i < toilets.size(); ++i) {
-        double x = x_from_lon(toilets[i].first.longitude());
-        double y = y_from_lat(toilets[i].first.latitude());
-//        if (scale >1.435)
-        g->set_color(ezgl::BLACK);
-        g->set_font_size(12);
-        g->draw_text({x, y - 4}, toilets[i].second, 100000, 1000000);
+// names of the icons of the layer drawn this frame, as label candidates under them,
+// item i of the layer is location i
+static void add_icon_labels(const IconLayer& layer, const std::vector<std::pair<LatLon, std::string>>& locations) {
+    for (int i : layer.drawn) {
+        if (!locations[i].second.empty()) {
+            add_label_candidate(locations[i].second, {layer.x[i], layer.y[i] - 4}, 0, POI_LABEL_FONT_SIZE,
+                                ezgl::BLACK, POI_LABEL_PRIORITY);
+        }
     }
 }
 
+// toilet names, only for the toilet icons drawn this frame
+void add_toilet_labels () {
+    add_icon_labels(toilet_icons, toilets);
+}
+
 void draw_toilets_wheelchair (ezgl::renderer* g){
-    for(int i = 0; i < toilets_wheelchair.size(); ++i) {
-        double x = x_from_lon(toilets_wheelchair[i].first.longitude());
-        double y = y_from_lat(toilets_wheelchair[i].first.latitude());
-        g ->draw_surface(surface_toilet_wheelchair,{x,y}, 0.019);
-    }
+    draw_icon_layer(g, toilet_wheelchair_icons);
 }
 
-void draw_toilets_wheelchair_label (ezgl::renderer* g){
-    for(int i = 0; i < toilets_wheelchair.size(); ++i) {
-        double x = x_from_lon(toilets_wheelchair[i].first.longitude());
-        double y = y_from_lat(toilets_wheelchair[i].first.latitude());
-        g->set_color(ezgl::BLACK);
-        g->set_font_size(12);
-        g->draw_text({x,y-4},toilets_wheelchair[i].second, 100000, 1000000);
-    }
+void add_toilets_wheelchair_labels (){
+    add_icon_labels(toilet_wheelchair_icons, toilets_wheelchair);
 }
 
 
@@ -333,304 +318,162 @@ int scale_ratio (double map_scale) {
 }
 
 
-// function draws street names on map
-void draw_street_name (ezgl::renderer* g, ezgl::point2d start, ezgl::point2d end, int index, int size) {
-
-    double center_text_x = (start.x + end.x)/2.0;
-    double center_text_y = (start.y + end.y)/2.0;
-
-    const ezgl::point2d top_right(g->get_visible_world().top_right());
-    const ezgl::point2d bottom_left(g->get_visible_world().bottom_left());
-
-    if (!((center_text_x>bottom_left.x) && (center_text_x<top_right.x) && (center_text_y>bottom_left.y) && (center_text_y<top_right.y) )){
-        return;
+// add the lines of the segment through its curve points to a batch for draw_lines,
+// from the points projected in loadMap at the level of detail of this frame
+void add_segment_lines(StreetSegmentIdx i, std::vector<ezgl::point2d>& lines) {
+    const ProjectedPolylines& polylines = lod_polylines(segment_lod, segment_xy);
+    for (int k = polylines.offsets[i]; k + 1 < polylines.offsets[i + 1]; ++k) {
+        lines.push_back({polylines.x[k], polylines.y[k]});
+        lines.push_back({polylines.x[k + 1], polylines.y[k + 1]});
     }
-    g->set_color(ezgl::BLACK);
-
-    StreetIdx street_id = getStreetSegmentInfo(index).streetID;
-    std::string street_display_name = getStreetName(street_id);
-    if ((street_display_name != "<unknown>") && (start != end) && ((size > 3) && (index % 2 == 0))) {
-
-        ezgl::point2d text_location = {center_text_x, center_text_y};
-
-        double angle_of_text = atan2((end.y - start.y), (end.x - start.x))/kDegreeToRadian;
-        if (angle_of_text < 0) {
-            angle_of_text += 180; // add pi
-        }
-        double segment_length = sqrt(pow((end.y - start.y), 2) + pow((end.x - start.x), 2));
-        if ((sizeof(street_display_name) < segment_length)) {
-            g->set_text_rotation(angle_of_text);
-            g-> draw_text (text_location, street_display_name);
-        }
-        // make other texts normal rotation
-        g->set_text_rotation(0);
-    }
-
-    g->set_color(202,202,202);
 }
 
+// draw the segment through its curve points
+void draw_segment_polyline(StreetSegmentIdx i, ezgl::renderer* g) {
+    static thread_local std::vector<ezgl::point2d> lines;
+    lines.clear();
+    add_segment_lines(i, lines);
+    g->draw_lines(lines.data(), lines.size());
+}
 
 void draw_seg_using_seg_id(StreetSegmentIdx i, ezgl::renderer* g){
-    int numCurvesInSeg = getStreetSegmentInfo(i).numCurvePoints;
-    LatLon start_lat_lon = getIntersectionPosition(getStreetSegmentInfo(i).from);
-    LatLon to_lat_lon = getIntersectionPosition(getStreetSegmentInfo(i).to);
-    ezgl::point2d start = {x_from_lon(start_lat_lon.longitude()), y_from_lat(start_lat_lon.latitude())};
-    ezgl::point2d end = {x_from_lon(to_lat_lon.longitude()), y_from_lat(to_lat_lon.latitude())};
-    // straight line and curves
-    if (numCurvesInSeg != 0) {
-
-        ezgl::point2d prev = start;
-        for (int j = 0; j < numCurvesInSeg; ++j) {
-            LatLon point = getStreetSegmentCurvePoint(j, i);
-            ezgl::point2d next = {x_from_lon(point.longitude()), y_from_lat(point.latitude())};
-            g->draw_line(prev, next);
-            prev = next;
-        }
-        g->draw_line(prev, end);
-    } else {
-        g->draw_line(start, end);
-    }
+    draw_segment_polyline(i, g);
 }
-// function draw all street segments of map at various scales
+// function draw all street segments of map at various scales, one road class at a time from the least important,
+// a class is drawn once the scale is above its threshold
+// recorded in the render queue: the minor streets share a layer, so in day mode they are all one stroke
 void draw_street_segments(ezgl::renderer* g, double scale){
-    g->set_line_width(2);
-    if(scale >0.08){
-        for(int i=0; i<quaternary_highway_nodes.size(); ++i){
-            LatLon from = quaternary_highway_nodes[i].first;
-            LatLon to = quaternary_highway_nodes[i].second;
-            ezgl::point2d from_from = {x_from_lon(from.longitude()), y_from_lat(from.latitude())};
-            ezgl::point2d to_to = {x_from_lon(to.longitude()), y_from_lat(to.latitude())};
-            if(!pinkify){
-                g->set_color(202,202,202);
-            }else{
-                g->set_color(98,111,138);
-            }
-
-            g->draw_line(from_from, to_to);
-
-        }
-    }
-
-
-
+    //reused between layers and frames (one per thread, tiles are drawn by the tile workers)
+    static thread_local std::vector<ezgl::point2d> lines;
 
     if(scale > 0.2){
-        if(!pinkify){
-            g->set_color(202,202,202);
+        if(!map_style.pinkify){
+            queue_style(MINOR_STREET_DRAW_LAYER, ezgl::color(202,202,202), 2);
         }else{
-            g->set_color(98,111,138);
-        }
-        for(int i=0; i<getNumStreetSegments(); ++i){
-            float street_seg_speed = 3.6 * (getStreetSegmentInfo(i).speedLimit);
-            if(street_seg_speed >90){
-                continue;
-            }
-            LatLon from = getIntersectionPosition(getStreetSegmentInfo(i).from);
-            LatLon to = getIntersectionPosition(getStreetSegmentInfo(i).to);
-            ezgl::point2d start = {x_from_lon(from.longitude()), y_from_lat(from.latitude())};
-            ezgl::point2d end = {x_from_lon(to.longitude()), y_from_lat(to.latitude())};
-            //This shows explored region, this section is for testing only
-            int numCurvesInSeg = getStreetSegmentInfo(i).numCurvePoints;
-            // straight line and curves
-            if (numCurvesInSeg != 0) {
-
-                ezgl::point2d prev = start;
-                for (int j = 0; j < numCurvesInSeg; ++j) {
-                    LatLon point = getStreetSegmentCurvePoint(j, i);
-                    ezgl::point2d next = {x_from_lon(point.longitude()), y_from_lat(point.latitude())};
-                    g->draw_line(prev, next);
-                    prev = next;
-                }
-                g->draw_line(prev, end);
-            } else {
-                g->draw_line(start, end);
-            }
-
-
+            queue_style(MINOR_STREET_DRAW_LAYER, ezgl::color(98,111,138), 2);
         }
+        lines.clear();
+        add_road_class_lines(OTHER_ROAD, lines);
+        add_road_class_lines(SERVICE_ROAD, lines);
+        add_road_class_lines(RESIDENTIAL_ROAD, lines);
+        add_road_class_lines(UNCLASSIFIED_ROAD, lines);
+        queue_lines(lines);
     }
 
-    if(scale >0.08){
-        for(int i=0; i<tertiary_highway_nodes.size(); ++i){
-            LatLon from = tertiary_highway_nodes[i].first;
-            LatLon to = tertiary_highway_nodes[i].second;
-            ezgl::point2d from_from = {x_from_lon(from.longitude()), y_from_lat(from.latitude())};
-            ezgl::point2d to_to = {x_from_lon(to.longitude()), y_from_lat(to.latitude())};
-            if(!pinkify){
-                g->set_color(202,202,202);
-            }else{
-                g->set_color(98,111,138);
-            }
-
-            g->draw_line(from_from, to_to);
-
-
-
-        }
-    }
-    if(scale >0.024){
-        for(int i=0; i<secondary_highway_nodes.size(); ++i){
-            LatLon from = secondary_highway_nodes[i].first;
-            LatLon to = secondary_highway_nodes[i].second;
-            ezgl::point2d from_from = {x_from_lon(from.longitude()), y_from_lat(from.latitude())};
-            ezgl::point2d to_to = {x_from_lon(to.longitude()), y_from_lat(to.latitude())};
-
-            if(!pinkify){
-                g->set_color(202,202,202);
-            }else{
-                g->set_color(108,121,148);
-            }
-
-            g->draw_line(from_from, to_to);
-        }
-    }
-
-    for(int i=0; i<primary_link_nodes.size(); ++i){
-        LatLon from = primary_link_nodes[i].first;
-        LatLon to = primary_link_nodes[i].second;
-        ezgl::point2d from_from = {x_from_lon(from.longitude()), y_from_lat(from.latitude())};
-        ezgl::point2d to_to = {x_from_lon(to.longitude()), y_from_lat(to.latitude())};
-
-        if(!pinkify){
-            g->set_color(208,208,208);
+    if(scale > 0.08){
+        if(!map_style.pinkify){
+            queue_style(MINOR_STREET_DRAW_LAYER, ezgl::color(202,202,202), 2);
         }else{
-            g->set_color(108,121,148);
+            queue_style(MINOR_STREET_DRAW_LAYER, ezgl::color(98,111,138), 2);
         }
-
-
-        g->draw_line(from_from, to_to);
+        lines.clear();
+        add_road_class_lines(TERTIARY_ROAD, lines);
+        queue_lines(lines);
     }
 
-
-    for(int i=0; i<primary_highway_nodes.size(); ++i){
-        LatLon from = primary_highway_nodes[i].first;
-        LatLon to = primary_highway_nodes[i].second;
-        ezgl::point2d from_from = {x_from_lon(from.longitude()), y_from_lat(from.latitude())};
-        ezgl::point2d to_to = {x_from_lon(to.longitude()), y_from_lat(to.latitude())};
-
-        if(!pinkify){
-            g->set_color(243,180,46);
+    if(scale > 0.024){
+        if(!map_style.pinkify){
+            queue_style(MINOR_STREET_DRAW_LAYER, ezgl::color(202,202,202), 2);
         }else{
-            g->set_color(108,121,148);
+            queue_style(MINOR_STREET_DRAW_LAYER, ezgl::color(108,121,148), 2);
         }
+        lines.clear();
+        add_road_class_lines(SECONDARY_ROAD, lines);
+        queue_lines(lines);
+    }
+
+    if(!map_style.pinkify){
+        queue_style(MAJOR_STREET_DRAW_LAYER, ezgl::color(243,180,46), 2);
+    }else{
+        queue_style(MAJOR_STREET_DRAW_LAYER, ezgl::color(108,121,148), 2);
+    }
+    lines.clear();
+    add_road_class_lines(PRIMARY_ROAD, lines);
+    queue_lines(lines);
+
+    // motorways and trunk roads over everything else
+    if(!map_style.pinkify){
+        queue_style(HIGHWAY_DRAW_LAYER, ezgl::color(243,180,46), 4);
+    }else{
+        queue_style(HIGHWAY_DRAW_LAYER, ezgl::color(108,121,148), 4);
+    }
+    lines.clear();
+    add_road_class_lines(TRUNK_ROAD, lines);
+    add_road_class_lines(MOTORWAY_ROAD, lines);
+    queue_lines(lines);
+}
 
-        g->draw_line(from_from, to_to);
-
-    }
-
-
-
-
-
-    if(scale > 2.5){
-        for(int i=0; i<getNumStreetSegments(); ++i){
-            LatLon from = getIntersectionPosition(getStreetSegmentInfo(i).from);
-            LatLon to = getIntersectionPosition(getStreetSegmentInfo(i).to);
-            ezgl::point2d start = {x_from_lon(from.longitude()), y_from_lat(from.latitude())};
-            ezgl::point2d end = {x_from_lon(to.longitude()), y_from_lat(to.latitude())};
-
-            if (pinkify) {
-
-                draw_street_name(g, start, end, i, getNumStreetSegments());
-
-            } else if (!pinkify) {
-
-                draw_street_name(g, start, end, i, getNumStreetSegments());
-            }
-
-        }
+// street names, label candidates on top of the street geometry (or its cached tiles)
+// a segment is a candidate when its name fits along it at this zoom, highways and longer segments first
+void add_street_labels(ezgl::renderer* g, double scale){
+    if(scale <= 2.5){
+        return;
     }
-
-    g->set_line_width(4);
-    for (size_t i=0; i<getNumStreetSegments(); ++i) {
-        LatLon from = getIntersectionPosition(getStreetSegmentInfo(i).from);
-        LatLon to = getIntersectionPosition(getStreetSegmentInfo(i).to);
-        ezgl::point2d start = {x_from_lon(from.longitude()), y_from_lat(from.latitude())};
-        ezgl::point2d end = {x_from_lon(to.longitude()), y_from_lat(to.latitude())};
-        float street_seg_speed = 3.6 * (getStreetSegmentInfo(i).speedLimit);
-        if(!pinkify){
-            g->set_color(243,180,46);
-        }else{
-            g->set_color(108,121,148);
+    for(StreetSegmentIdx i : visible_segments){
+        StreetSegmentInfo info = getStreetSegmentInfo(i);
+        const std::string& street_display_name = label_engine.street_names[info.streetID];
+        if (street_display_name == "<unknown>") {
+            continue;
         }
 
-        if (street_seg_speed <90){
+        ezgl::point2d start = {segment_xy.x[segment_xy.offsets[i]], segment_xy.y[segment_xy.offsets[i]]};
+        ezgl::point2d end = {segment_xy.x[segment_xy.offsets[i + 1] - 1], segment_xy.y[segment_xy.offsets[i + 1] - 1]};
+        double segment_length = sqrt(pow((end.y - start.y), 2) + pow((end.x - start.x), 2));
+        if (segment_length * scale < STREET_LABEL_MIN_PIXELS) {
             continue;
         }
-        // limit the visibility of streets at different scales
-
-
-        int numCurvesInSeg = getStreetSegmentInfo(i).numCurvePoints;
-        // straight line and curves
-        if (numCurvesInSeg != 0) {
-
-            ezgl::point2d prev = start;
-            for (int j = 0; j < numCurvesInSeg; ++j) {
-                LatLon point = getStreetSegmentCurvePoint(j, i);
-                ezgl::point2d next = {x_from_lon(point.longitude()), y_from_lat(point.latitude())};
-                g->draw_line(prev, next);
-                prev = next;
-            }
-            g->draw_line(prev, end);
-        } else {
-            g->draw_line(start, end);
+        const ezgl::renderer::text_extents& extents = label_text_extents(g, street_display_name, STREET_LABEL_FONT_SIZE);
+        if (extents.width >= segment_length * scale) {
+            continue;
         }
 
-        if (scale  > 2.5 && pinkify) {
-            g->set_color(ezgl::WHITE);
-            draw_street_name(g, start, end, i, getNumStreetSegments());
-        } else if (scale > 2.5 && !pinkify) {
-            g->set_color(ezgl::BLACK);
-            draw_street_name(g, start, end, i, getNumStreetSegments());
+        // along the segment, turned so the text never reads upside down
+        double angle_of_text = atan2((end.y - start.y), (end.x - start.x))/kDegreeToRadian;
+        if (angle_of_text > 90) {
+            angle_of_text -= 180;
+        } else if (angle_of_text <= -90) {
+            angle_of_text += 180;
         }
 
-    }
-
-
-    for(int i=0; i<getNumStreetSegments(); ++i){
-
-
-        if(segment_highlighted[i]){
-            g->set_color(ezgl::YELLOW);
-
-            draw_seg_using_seg_id(i, g);
+        double priority = segment_length;
+        if (segment_road_class[i] <= TRUNK_ROAD) {
+            priority += HIGHWAY_LABEL_PRIORITY;
         }
+        ezgl::point2d text_location = {(start.x + end.x)/2.0, (start.y + end.y)/2.0};
+        add_label_candidate(street_display_name, text_location, angle_of_text, STREET_LABEL_FONT_SIZE, ezgl::BLACK, priority);
     }
-
 }
 
-
-// draw all subway routes on map
-// initlialize subway and railway routes
+// draw the subway rails on screen, from the OSM way nodes projected in loadMap
 void draw_subway_routes(ezgl::renderer* g){
-    if (subway_show){
-        for (int i=0; i<subway_nodes.size(); ++i){
-            LatLon from = subway_nodes[i].first;
-            LatLon to = subway_nodes[i].second;
-            ezgl::point2d from_from = {x_from_lon(from.longitude()), y_from_lat(from.latitude())};
-            ezgl::point2d to_to = {x_from_lon(to.longitude()), y_from_lat(to.latitude())};
-            g->set_color(231,126,45);
-            g->set_line_width(2);
-
-            g->draw_line(from_from, to_to);
-
-
+    if (map_style.subway_show){
+        static thread_local std::vector<int> visible;
+        static thread_local std::vector<ezgl::point2d> lines;
+        query_spatial_grid(subway_grid, g->get_cull_world(), visible);
+        lines.clear();
+        for (int k : visible) {
+            int way = subway_ways[k];
+            for (int p = way_xy.offsets[way]; p + 1 < way_xy.offsets[way + 1]; ++p) {
+                lines.push_back({way_xy.x[p], way_xy.y[p]});
+                lines.push_back({way_xy.x[p + 1], way_xy.y[p + 1]});
+            }
         }
+        queue_style(SUBWAY_DRAW_LAYER, ezgl::color(231,126,45), 2);
+        queue_lines(lines);
     }
 
 }
 
 
 
-// draw main canvas of world on map
-void draw_main_canvas_xy_fixed_world (ezgl:: renderer *g) {
-    // draw canvas
-    if(pinkify){
+// fill the visible world with the background colour of the current style
+void draw_map_background(ezgl::renderer* g){
+    if(map_style.pinkify){
         ezgl::rectangle visible_world = g->get_visible_world();
         g->set_color(36, 39, 43); // black: DARK MODE
         g->fill_rectangle(visible_world);
     }
-    if(!pinkify){
+    if(!map_style.pinkify){
         ezgl::rectangle visible_world = g->get_visible_world();
         g->set_color(215, 215, 215);
         g->fill_rectangle(visible_world);
@@ -639,11 +482,10 @@ void draw_main_canvas_xy_fixed_world (ezgl:: renderer *g) {
     g->set_line_width(10);
     g->set_color(255, 248, 196);
     g->draw_rectangle({0,0},{1000,1000});
+}
 
-    //draw all features on map
-    //draw all features on map in order
-    double map_scale = distance_scaling_fct(g);
-
+//draw all features on map in order
+void draw_map_features(ezgl::renderer* g, double map_scale){
     draw_parks(g);
     if(map_scale > 0.195) {
         draw_buildings(g);
@@ -666,27 +508,134 @@ void draw_main_canvas_xy_fixed_world (ezgl:: renderer *g) {
     if(map_scale > 0.025) {
         draw_streams(g);
     }
+}
 
+// the toggles as they are now, only called on the GTK thread that changes them
+MapStyle current_map_style(){
+    MapStyle style;
+    style.pinkify = pinkify;
+    style.subway_show = subway_show;
+    return style;
+}
+
+// the style as one int, to compare the style a cached image was drawn with
+int map_style_key(const MapStyle& style){
+    return int(style.pinkify) | (int(style.subway_show) << 1);
+}
+
+MapStyle map_style_from_key(int key){
+    MapStyle style;
+    style.pinkify = (key & 1) != 0;
+    style.subway_show = (key & 2) != 0;
+    return style;
+}
+
+// the part of the map that is cached in tiles: background, features, streets and subway routes,
+// no text and nothing that changes with the search or path state
+void draw_map_base(ezgl::renderer* g, double map_scale){
+    draw_map_background(g);
+    clear_render_queue();
+    draw_map_features(g, map_scale);
     draw_street_segments(g, map_scale);
     draw_subway_routes(g);
+    flush_render_queue(g);
+}
+
+// draw one tile of the tile cache or one strip of a parallel redraw, called on worker threads
+// with a renderer on the tile or strip image, after the worker set map_style.
+// The lines just outside the image are drawn too, as far as the widest stroke (the feature
+// outlines) reaches into it, or they would be cut along the edges between images
+void draw_map_tile(ezgl::renderer* g){
+    double world_per_pixel = g->get_visible_world().width() / g->get_visible_screen().width();
+    g->set_cull_margin(FEATURE_LINE_WIDTH / 2.0 * world_per_pixel);
+    load_visible_items(g->get_cull_world());
+    select_lod_level(g);
+    draw_map_base(g, distance_scaling_fct(g));
+}
+
+// the icons and labels drawn on top of the map base,
+// drawn on the GTK thread, or one image at a time by the headless renderer
+void draw_map_overlay(ezgl::renderer* g, double map_scale){
+    begin_icons(g);
+
+    begin_render_pass(SUBWAY_PASS);
     // subway_station
     if(map_scale > 0.145) {
         draw_subway_station(g);
     }
+    end_render_pass(SUBWAY_PASS);
+
+    begin_render_pass(POIS_PASS);
     if(map_scale > 0.685) {
         draw_toilet(g);
     }
-    if(map_scale > 3) {
-        draw_toilet_label(g);
-    }
     if(map_scale > 0.685) {
         draw_toilets_wheelchair(g);
     }
+    end_render_pass(POIS_PASS);
+
+    // every label of the frame is placed at once, so the ones that would overlap are dropped
+    begin_render_pass(LABELS_PASS);
+    begin_labels(g);
+    add_street_labels(g, map_scale);
+    if(map_scale > 3) {
+        add_toilet_labels();
+    }
     if(map_scale > 3) {
-        draw_toilets_wheelchair_label(g);
+        add_toilets_wheelchair_labels();
     }
-    initial_intersections();
-    draw_intersections(g);
+    place_and_draw_labels(g);
+    end_render_pass(LABELS_PASS);
+}
+
+// the frame under the route overlay, drawn into the base layer
+void draw_map_frame(ezgl::renderer* g) {
+    map_style = current_map_style();
+    load_visible_items(g->get_visible_world());
+    select_lod_level(g);
+    double map_scale = distance_scaling_fct(g);
+
+    // draw canvas: the cached tiles if they cover the view, else the whole base in parallel strips
+    // or on this thread like before
+    begin_render_pass(TILES_PASS);
+    bool tiles_drawn = tile_cache.enabled && tile_cache.canvas != nullptr && draw_cached_tiles(g);
+    end_render_pass(TILES_PASS);
+
+    if (!tiles_drawn && parallel_render && main_canvas != nullptr) {
+        begin_render_pass(STRIPS_PASS);
+        main_canvas->render_parallel(g, draw_map_tile, num_render_threads(), run_on_tile_workers);
+        // this thread drew strips too, which left it with the items and level of its last strip
+        load_visible_items(g->get_visible_world());
+        select_lod_level(g);
+        end_render_pass(STRIPS_PASS);
+    } else if (!tiles_drawn) {
+        begin_render_pass(FEATURES_PASS);
+        draw_map_background(g);
+        clear_render_queue();
+        draw_map_features(g, map_scale);
+        flush_render_queue(g);
+        end_render_pass(FEATURES_PASS);
+
+        begin_render_pass(STREETS_PASS);
+        draw_street_segments(g, map_scale);
+        flush_render_queue(g);
+        end_render_pass(STREETS_PASS);
+
+        begin_render_pass(SUBWAY_PASS);
+        draw_subway_routes(g);
+        flush_render_queue(g);
+        end_render_pass(SUBWAY_PASS);
+    }
+
+    draw_map_overlay(g, map_scale);
+}
+
+// draw main canvas of world on map
+// the map comes from the base layer when only the route or the highlights changed since the last frame
+void draw_main_canvas_xy_fixed_world (ezgl:: renderer *g) {
+    begin_frame(g);
+    draw_base_layer(g);
+    draw_route_overlay(g);
 
     if(!pinkify){
         g->set_color(ezgl::BLACK);
@@ -695,6 +644,7 @@ void draw_main_canvas_xy_fixed_world (ezgl:: renderer *g) {
         g->set_color(ezgl::WHITE);
     }
 
+    end_frame(g);
 }
 
 // gtk mouse click
@@ -729,6 +679,8 @@ void act_on_mouse_click(ezgl::application* app, GdkEventButton* /*event*/, doubl
         start_end.second = highlighted[1];
 
 
+        //only the segments explored by this search are played back
+        popped.clear();
         std::vector<StreetSegmentIdx> path = findPathBetweenIntersections(15,start_end);
 
         find_direction(path);
@@ -736,16 +688,7 @@ void act_on_mouse_click(ezgl::application* app, GdkEventButton* /*event*/, doubl
 
         std::cout<< "Path size is:"<<path.size() << std::endl;
 
-        for(int i=0; i<popped.size();++i){
-            explore_highlighted[popped[i]] = true;
-
-        }
-
-
-        for(int i=0; i<path.size(); ++i){
-
-            segment_highlighted[path[i]] = true;
-        }
+        set_route_overlay(path, popped);
     }
 
     app->refresh_drawing();
@@ -813,11 +756,6 @@ void take_map_input(GtkWidget* /*widget*/, ezgl::application* application){
     rend->set_visible_world(initial_world); //update the renderer to have the coords of the new world location
 
 
-    load_subway_png();
-    load_toilet_png();
-    load_toilet_wheelchair_png();
-    load_location_png();
-
     draw_main_canvas_xy_fixed_world(rend);
     application->refresh_drawing();
 }
@@ -922,8 +860,9 @@ void find_intersections(GtkWidget* /*widget*/, ezgl::application* application){
     street2.replace(0, pos+1,"");
 
     // warning messages
-    std::vector<StreetIdx> street_ids_from_partial_street_input1 = findStreetIdsFromPartialStreetName(street1);
-    std::vector<StreetIdx> street_ids_from_partial_street_input2 = findStreetIdsFromPartialStreetName(street2);
+    // a typo in the street name still finds the closest street
+    std::vector<StreetIdx> street_ids_from_partial_street_input1 = find_street_ids_with_typos(street1);
+    std::vector<StreetIdx> street_ids_from_partial_street_input2 = find_street_ids_with_typos(street2);
 
     if((street_ids_from_partial_street_input1[0] == -1) || (street_ids_from_partial_street_input2[0] == -1)){
 
@@ -975,9 +914,7 @@ void find_intersections(GtkWidget* /*widget*/, ezgl::application* application){
         find_direction(path);
         find_total_time(path);
 
-        for(int i=0; i<path.size(); ++i){
-            segment_highlighted[path[i]] = true;
-        }
+        set_route_overlay(path, {});
     }
 
     application->refresh_drawing();
@@ -1008,6 +945,14 @@ gboolean show_subways (GtkSwitch* /*subways_switch*/, gboolean switch_state, ezg
     return false;
 }
 
+// "Parallel" button: switch between drawing the map base on all cores and on the GTK thread only
+void toggle_parallel_render(GtkWidget* /*widget*/, ezgl::application* application){
+    parallel_render = !parallel_render;
+    application->update_message(parallel_render ? "Parallel drawing on" : "Parallel drawing off");
+    invalidate_base_layer();
+    application->refresh_drawing();
+}
+
 // initialize labels and switchs
 void initial_setup_pinkify_switch_with_text (ezgl::application* application, bool /*new window*/) {
     GObject* pink_switch = application  -> get_object ("PinkSwitch");
@@ -1021,12 +966,20 @@ void initial_setup_pinkify_switch_with_text (ezgl::application* application, boo
     application->create_button("Find Path", 9, find_path);
     application->create_button("Help? Click me :)", 18, help_information);
     application->create_button("Direction", 17, display_direction);
+    application->create_button("Profiler", 19, toggle_profiler_overlay);
+    application->create_button("Profiler CSV", 20, dump_profiler_csv_button);
+    application->create_button("Tiles", 21, toggle_tile_cache);
+    application->create_button("Parallel", 22, toggle_parallel_render);
+    application->create_button("Replay Search", 23, play_search_exploration);
+    main_canvas = application->get_canvas(application->get_main_canvas_id());
+    start_tile_cache(application);
 }
 void find_total_time(std::vector<StreetSegmentIdx> path){
+    double path_time = 0.0;
     for(int i = 0; i<path.size(); ++i){
-        double time = findStreetSegmentLength(i)/getStreetSegmentInfo(i).speedLimit;
-        total_time += time;
+        path_time += findStreetSegmentTravelTime(path[i]);
     }
+    total_time += path_time;
     //total time need to be minutes
     if ((0 < total_time) && ( 60 >= total_time)){
         total_time = 1;
@@ -1125,70 +1078,21 @@ void find_direction(std::vector<StreetSegmentIdx> path){
 
 // helper function for find the turn to right or left
 // from "first" street segment turn to "second" street segment
-// use the cross product
+// use the sign of the turn angle at the shared intersection
 std::string find_turn_to(StreetSegmentIdx first, StreetSegmentIdx second) {
-    IntersectionIdx p1_x = 0;
-    IntersectionIdx p2_x = 0;
-    IntersectionIdx p3_x = 0;
-    IntersectionIdx p1_y = 0;
-    IntersectionIdx p2_y = 0;
-    IntersectionIdx p3_y = 0;
     std::string turn;
+    double turn_angle = signed_turn_angle(first, second);
 
-    IntersectionIdx point1 = getStreetSegmentInfo(first).from;
-    IntersectionIdx point2 = getStreetSegmentInfo(first).to;
-    IntersectionIdx point3 = getStreetSegmentInfo(second).from;
-    IntersectionIdx point4 = getStreetSegmentInfo(second).to;
-
-    if (point1 == point3){
-        p1_x = x_from_lon(getIntersectionPosition(point2).longitude());
-        p2_x = x_from_lon(getIntersectionPosition(point1).longitude());
-        p3_x = x_from_lon(getIntersectionPosition(point4).longitude());
-        p1_y = y_from_lat(getIntersectionPosition(point2).latitude());
-        p2_y = y_from_lat(getIntersectionPosition(point1).latitude());
-        p3_y = y_from_lat(getIntersectionPosition(point4).latitude());
-    }
-
-    if (point1 == point4){
-        p1_x = x_from_lon(getIntersectionPosition(point2).longitude());
-        p2_x = x_from_lon(getIntersectionPosition(point1).longitude());
-        p3_x = x_from_lon(getIntersectionPosition(point3).longitude());
-        p1_y = y_from_lat(getIntersectionPosition(point2).latitude());
-        p2_y = y_from_lat(getIntersectionPosition(point1).latitude());
-        p3_y = y_from_lat(getIntersectionPosition(point3).latitude());
-    }
-
-    if (point2 == point3){
-        p1_x = x_from_lon(getIntersectionPosition(point1).longitude());
-        p2_x = x_from_lon(getIntersectionPosition(point2).longitude());
-        p3_x = x_from_lon(getIntersectionPosition(point4).longitude());
-        p1_y = y_from_lat(getIntersectionPosition(point1).latitude());
-        p2_y = y_from_lat(getIntersectionPosition(point2).latitude());
-        p3_y = y_from_lat(getIntersectionPosition(point4).latitude());
-    }
-
-    if (point2 == point4){
-        p1_x = x_from_lon(getIntersectionPosition(point1).longitude());
-        p2_x = x_from_lon(getIntersectionPosition(point2).longitude());
-        p3_x = x_from_lon(getIntersectionPosition(point3).longitude());
-        p1_y = y_from_lat(getIntersectionPosition(point1).latitude());
-        p2_y = y_from_lat(getIntersectionPosition(point2).latitude());
-        p3_y = y_from_lat(getIntersectionPosition(point3).latitude());
-    }
-
-    double delta_x1 = p2_x - p1_x;
-    double delta_y1 = p2_y - p1_y;
-    double delta_x2 = p3_x - p2_x;
-    double delta_y2 = p3_y - p2_y;
-
-    //turn right -> (cross product < 0)
-    //turn left -> (cross product > 0)
-    //go straight -> (cross product = 0)
-    double cross_product = delta_x1 * delta_y2 - delta_y1 * delta_x2;
-    if (cross_product > 0) {
+    //turn left -> (angle > 0)
+    //turn right -> (angle < 0)
+    //go straight or not connected -> (empty)
+    if (turn_angle == NO_ANGLE) {
+        return turn;
+    }
+    if (turn_angle > 0) {
         turn = "left";
     }
-    if (cross_product < 0) {
+    if (turn_angle < 0) {
         turn = "right";
     }
     return turn;
@@ -1294,24 +1198,14 @@ void display_direction(GtkWidget* /*widget*/, ezgl::application* application){
 
 //clear all highlights on the map
 void clear_highlight(GtkWidget* /*widget*/, ezgl::application* application){
-    for (int i=0; i<getNumIntersections(); ++i){
+    for (IntersectionIdx i : highlighted){
         intersections[i].highlight = false;
     }
-
-    for (int i=0; i<getNumStreetSegments(); ++i){
-        segment_highlighted[i]=false;
-        explore_highlighted[i]=false;
-    }
+    clear_route_overlay();
 
     std::vector<IntersectionIdx> ().swap(highlighted);
     std::vector<StreetSegmentIdx>().swap(popped);
 
-    //clear all visited and reaching edge of Nodes
-    for (int i=0; i<Nodes.size(); ++i){
-        Nodes[i].visited = false;
-        Nodes[i].best_route_time = 99999;
-    }
-
     application -> refresh_drawing();
 }
 
@@ -1365,5 +1259,6 @@ void draw_map_intersections_xy_fixed_world() {
 
 
     application.run(initial_setup_pinkify_switch_with_text, act_on_mouse_click, nullptr, nullptr);
+    stop_tile_cache();
     // run initial setup using pinkify switch callback
 }
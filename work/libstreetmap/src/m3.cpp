@@ -69,7 +69,7 @@ double travel_time(StreetSegmentIdx last_edge, StreetSegmentIdx next_edge, doubl
 
 // This function computes the fastest total time to reach destination if I travel as fastest possible speed
 double find_fastest_possible_time(IntersectionIdx my_location, IntersectionIdx destination, double total_travel_time_so_far){
-    double distance = findDistanceBetweenTwoPoints(getIntersectionPosition(my_location), getIntersectionPosition(destination));
+    double distance = point_distance(intersection_points, my_location, destination);
     double time = distance / max_speed + total_travel_time_so_far;
 
     return time;
@@ -0,0 +1,178 @@
+//
+// Columnar store of the OSM tags of every node, way and relation
+//
+
+#include "global.h"
+
+// Initialize value here
+OSMStringPool osm_tag_strings;
+OSMTagTable node_tags;
+OSMTagTable way_tags;
+OSMTagTable relation_tags;
+std::vector<OSMTagQuery> osm_tag_queries;
+int osm_layer_queries[NUM_OSM_LAYERS];
+
+// value id meaning the query matches the key with any value
+#define OSM_ANY_VALUE -2
+
+// id of the string in the pool, the string is added if it is new
+int intern_osm_string(const std::string& str) {
+    auto it = osm_tag_strings.ids.find(str);
+    if (it != osm_tag_strings.ids.end()) {
+        return it->second;
+    }
+
+    int id = osm_tag_strings.strings.size();
+    osm_tag_strings.strings.push_back(str);
+    osm_tag_strings.ids.emplace(str, id);
+    return id;
+}
+
+// id of the string in the pool, -1 if no tag uses it (so it never compares equal to a tag)
+int find_osm_string(const std::string& str) {
+    auto it = osm_tag_strings.ids.find(str);
+    return (it == osm_tag_strings.ids.end()) ? -1 : it->second;
+}
+
+const std::string& osm_string(int id) {
+    return osm_tag_strings.strings[id];
+}
+
+// append the tags of one entity to the table, sorted by key id for the binary search
+template <typename Entity>
+static void append_osm_tags(OSMTagTable& table, const Entity* entity,
+                            std::vector<std::pair<int, int>>& entity_tags) {
+    entity_tags.clear();
+    int tag_count = getTagCount(entity);
+    for (int j = 0; j < tag_count; ++j) {
+        std::pair<std::string, std::string> tag = getTagPair(entity, j);
+        entity_tags.push_back(std::make_pair(intern_osm_string(tag.first), intern_osm_string(tag.second)));
+    }
+    // stable: a repeated key keeps the value that came first, like the old linear scans
+    std::stable_sort(entity_tags.begin(), entity_tags.end(),
+                     [](const std::pair<int, int>& lhs, const std::pair<int, int>& rhs) {
+                         return lhs.first < rhs.first;
+                     });
+
+    for (int j = 0; j < entity_tags.size(); ++j) {
+        table.key_ids.push_back(entity_tags[j].first);
+        table.value_ids.push_back(entity_tags[j].second);
+    }
+    table.offsets.push_back(table.key_ids.size());
+}
+
+// one pass over every entity of the OSM database, called from build_OSM_Database
+void load_osm_tags() {
+    std::vector<std::pair<int, int>> entity_tags;
+
+    node_tags.offsets.assign(1, 0);
+    node_tags.offsets.reserve(getNumberOfNodes() + 1);
+    for (int i = 0; i < getNumberOfNodes(); ++i) {
+        append_osm_tags(node_tags, getNodeByIndex(i), entity_tags);
+    }
+
+    way_tags.offsets.assign(1, 0);
+    way_tags.offsets.reserve(getNumberOfWays() + 1);
+    for (int i = 0; i < getNumberOfWays(); ++i) {
+        append_osm_tags(way_tags, getWayByIndex(i), entity_tags);
+    }
+
+    relation_tags.offsets.assign(1, 0);
+    relation_tags.offsets.reserve(getNumberOfRelations() + 1);
+    for (int i = 0; i < getNumberOfRelations(); ++i) {
+        append_osm_tags(relation_tags, getRelationByIndex(i), entity_tags);
+    }
+}
+
+void clear_osm_tags() {
+    osm_tag_strings = OSMStringPool();
+    node_tags = OSMTagTable();
+    way_tags = OSMTagTable();
+    relation_tags = OSMTagTable();
+    std::vector<OSMTagQuery>().swap(osm_tag_queries);
+}
+
+// value id of the key on the entity (index in the OSM database), -1 if the key is not set
+int find_osm_tag(const OSMTagTable& table, int entity, int key_id) {
+    if (key_id == -1) {
+        return -1;
+    }
+
+    auto first = table.key_ids.begin() + table.offsets[entity];
+    auto last = table.key_ids.begin() + table.offsets[entity + 1];
+    auto it = std::lower_bound(first, last, key_id);
+    if (it == last || *it != key_id) {
+        return -1;
+    }
+    return table.value_ids[it - table.key_ids.begin()];
+}
+
+// true if the entity has the tag key=value
+bool has_osm_tag(const OSMTagTable& table, int entity, int key_id, int value_id) {
+    return value_id != -1 && find_osm_tag(table, entity, key_id) == value_id;
+}
+
+// register a layer: every entity of this kind with the tag key=value (any value if value is empty)
+// returns the id of the query in osm_tag_queries, the matches are filled by run_osm_tag_queries
+int register_osm_tag_query(OSMEntityKind kind, const std::string& key, const std::string& value) {
+    OSMTagQuery query;
+    query.kind = kind;
+    query.key = key;
+    query.value = value;
+    osm_tag_queries.push_back(query);
+    return osm_tag_queries.size() - 1;
+}
+
+// answer all the queries on one kind of entity with a single pass split between the threads
+static void run_osm_tag_queries_on(const OSMTagTable& table, OSMEntityKind kind) {
+    std::vector<int> queries, key_ids, value_ids;
+    for (int q = 0; q < osm_tag_queries.size(); ++q) {
+        if (osm_tag_queries[q].kind != kind) {
+            continue;
+        }
+        queries.push_back(q);
+        key_ids.push_back(find_osm_string(osm_tag_queries[q].key));
+        value_ids.push_back(osm_tag_queries[q].value.empty() ? OSM_ANY_VALUE
+                                                              : find_osm_string(osm_tag_queries[q].value));
+    }
+    if (queries.empty() || table.offsets.empty()) {
+        return;
+    }
+
+    int num_entities = table.offsets.size() - 1;
+    int num_threads = omp_get_max_threads();
+    //[thread][query] = matching entities seen by that thread
+    std::vector<std::vector<std::vector<int>>> found(num_threads, std::vector<std::vector<int>>(queries.size()));
+
+    #pragma omp parallel num_threads(num_threads)
+    {
+        std::vector<std::vector<int>>& thread_found = found[omp_get_thread_num()];
+
+        #pragma omp for schedule(static)
+        for (int i = 0; i < num_entities; ++i) {
+            for (int q = 0; q < queries.size(); ++q) {
+                int value = find_osm_tag(table, i, key_ids[q]);
+                if (value != -1 && (value_ids[q] == OSM_ANY_VALUE || value == value_ids[q])) {
+                    thread_found[q].push_back(i);
+                }
+            }
+        }
+    }
+
+    // a static schedule gives the threads consecutive blocks in order,
+    // so joining them thread by thread keeps the matches in database order
+    for (int q = 0; q < queries.size(); ++q) {
+        std::vector<int>& matches = osm_tag_queries[queries[q]].matches;
+        matches.clear();
+        for (int t = 0; t < num_threads; ++t) {
+            matches.insert(matches.end(), found[t][q].begin(), found[t][q].end());
+        }
+    }
+}
+
+// answer every registered query, one pass over the nodes, the ways and the relations
+void run_osm_tag_queries() {
+    run_osm_tag_queries_on(node_tags, OSM_NODE);
+    run_osm_tag_queries_on(way_tags, OSM_WAY);
+    run_osm_tag_queries_on(relation_tags, OSM_RELATION);
+}
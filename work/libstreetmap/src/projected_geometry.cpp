@@ -0,0 +1,179 @@
+//
+// Map geometry projected once to the x/y world coordinates the map is drawn in
+//
+
+#include "global.h"
+
+// Initialize value here
+MapProjection map_projection;
+ProjectedPoints intersection_xy;
+ProjectedPoints poi_xy;
+ProjectedPolylines segment_xy;
+ProjectedPolylines feature_xy;
+ProjectedPolylines way_xy;
+FeatureMetadataTable feature_metadata;
+
+// cache the projection constants for the current avg_lat, called from load_max_min_lat_lon
+void load_map_projection() {
+    map_projection.cos_avg_lat = std::cos(avg_lat * kDegreeToRadian);
+    map_projection.x_per_degree = kDegreeToRadian * kEarthRadiusInMeters * map_projection.cos_avg_lat;
+    map_projection.y_per_degree = kDegreeToRadian * kEarthRadiusInMeters;
+}
+
+static void add_projected_point(std::vector<double>& x, std::vector<double>& y, LatLon point) {
+    x.push_back(point.longitude() * map_projection.x_per_degree);
+    y.push_back(point.latitude() * map_projection.y_per_degree);
+}
+
+// project every intersection, POI, segment polyline, feature polygon and OSM way,
+// called from loadMap after load_max_min_lat_lon
+void load_projected_geometry() {
+    intersection_xy.x.reserve(getNumIntersections());
+    intersection_xy.y.reserve(getNumIntersections());
+    for (int i = 0; i < getNumIntersections(); ++i) {
+        add_projected_point(intersection_xy.x, intersection_xy.y, getIntersectionPosition(i));
+    }
+
+    poi_xy.x.reserve(getNumPointsOfInterest());
+    poi_xy.y.reserve(getNumPointsOfInterest());
+    for (int i = 0; i < getNumPointsOfInterest(); ++i) {
+        add_projected_point(poi_xy.x, poi_xy.y, getPOIPosition(i));
+    }
+
+    // segments: from intersection, curve points, to intersection
+    segment_xy.offsets.assign(1, 0);
+    segment_xy.offsets.reserve(getNumStreetSegments() + 1);
+    for (int i = 0; i < getNumStreetSegments(); ++i) {
+        StreetSegmentInfo info = getStreetSegmentInfo(i);
+        segment_xy.x.push_back(intersection_xy.x[info.from]);
+        segment_xy.y.push_back(intersection_xy.y[info.from]);
+        for (int j = 0; j < info.numCurvePoints; ++j) {
+            add_projected_point(segment_xy.x, segment_xy.y, getStreetSegmentCurvePoint(j, i));
+        }
+        segment_xy.x.push_back(intersection_xy.x[info.to]);
+        segment_xy.y.push_back(intersection_xy.y[info.to]);
+        segment_xy.offsets.push_back(segment_xy.x.size());
+    }
+
+    feature_xy.offsets.assign(1, 0);
+    feature_xy.offsets.reserve(getNumFeatures() + 1);
+    for (int i = 0; i < getNumFeatures(); ++i) {
+        for (int j = 0; j < getNumFeaturePoints(i); ++j) {
+            add_projected_point(feature_xy.x, feature_xy.y, getFeaturePoint(j, i));
+        }
+        feature_xy.offsets.push_back(feature_xy.x.size());
+    }
+
+    way_xy.offsets.assign(1, 0);
+    way_xy.offsets.reserve(Way_LatLon_of_Nodes.size() + 1);
+    for (int i = 0; i < Way_LatLon_of_Nodes.size(); ++i) {
+        for (int j = 0; j < Way_LatLon_of_Nodes[i].size(); ++j) {
+            add_projected_point(way_xy.x, way_xy.y, Way_LatLon_of_Nodes[i][j]);
+        }
+        way_xy.offsets.push_back(way_xy.x.size());
+    }
+}
+
+// area, bounding box, centroid and closed flag of every feature from its projected points,
+// called from loadMap after load_projected_geometry
+void load_feature_metadata() {
+    int numFeatures = feature_xy.offsets.size() - 1;
+
+    feature_metadata.area.resize(numFeatures);
+    feature_metadata.min_x.resize(numFeatures);
+    feature_metadata.max_x.resize(numFeatures);
+    feature_metadata.min_y.resize(numFeatures);
+    feature_metadata.max_y.resize(numFeatures);
+    feature_metadata.centroid_x.resize(numFeatures);
+    feature_metadata.centroid_y.resize(numFeatures);
+    feature_metadata.closed.resize(numFeatures);
+    feature_metadata.num_points.resize(numFeatures);
+    feature_metadata.draw_size.resize(numFeatures);
+
+    #pragma omp parallel for schedule(dynamic, 256)
+    for (int i = 0; i < numFeatures; ++i) {
+        int first = feature_xy.offsets[i];
+        int last = feature_xy.offsets[i + 1] - 1;
+        int num_points = last - first + 1;
+        feature_metadata.num_points[i] = num_points;
+        feature_metadata.area[i] = 0.0;
+        feature_metadata.closed[i] = false;
+        feature_metadata.draw_size[i] = 0.0;
+        if (num_points == 0) {
+            continue;
+        }
+        //points are drawn as a fixed size marker, always kept
+        if (num_points == 1) {
+            feature_metadata.draw_size[i] = std::numeric_limits<double>::infinity();
+        }
+        const double* x = feature_xy.x.data();
+        const double* y = feature_xy.y.data();
+
+        double min_x = x[first], max_x = x[first];
+        double min_y = y[first], max_y = y[first];
+        double sum_x = 0.0, sum_y = 0.0;
+        for (int k = first; k <= last; ++k) {
+            min_x = std::min(min_x, x[k]);
+            max_x = std::max(max_x, x[k]);
+            min_y = std::min(min_y, y[k]);
+            max_y = std::max(max_y, y[k]);
+            sum_x += x[k];
+            sum_y += y[k];
+        }
+
+        feature_metadata.min_x[i] = min_x;
+        feature_metadata.max_x[i] = max_x;
+        feature_metadata.min_y[i] = min_y;
+        feature_metadata.max_y[i] = max_y;
+        feature_metadata.centroid_x[i] = sum_x / num_points;
+        feature_metadata.centroid_y[i] = sum_y / num_points;
+
+        bool closed = num_points >= 3 && x[first] == x[last] && y[first] == y[last];
+        feature_metadata.closed[i] = closed;
+        if (!closed) {
+            if (num_points > 1) {
+                double side = std::max(max_x - min_x, max_y - min_y);
+                feature_metadata.draw_size[i] = side * side;
+            }
+            continue;
+        }
+
+        // shoelace formula relative to the first point, with the centroid of the polygon
+        double cross_sum = 0.0, cx_sum = 0.0, cy_sum = 0.0;
+        for (int k = first; k < last; ++k) {
+            double x0 = x[k] - x[first], y0 = y[k] - y[first];
+            double x1 = x[k + 1] - x[first], y1 = y[k + 1] - y[first];
+            double cross = x0 * y1 - x1 * y0;
+            cross_sum += cross;
+            cx_sum += (x0 + x1) * cross;
+            cy_sum += (y0 + y1) * cross;
+        }
+        if (cross_sum != 0.0) {
+            feature_metadata.centroid_x[i] = x[first] + cx_sum / (3.0 * cross_sum);
+            feature_metadata.centroid_y[i] = y[first] + cy_sum / (3.0 * cross_sum);
+        }
+
+        // the world x is scaled by the cosine of the map's average latitude,
+        // the area in meters uses the cosine of the feature's own average latitude
+        double lat_avg = sum_y / num_points / map_projection.y_per_degree * kDegreeToRadian;
+        feature_metadata.area[i] = std::abs(cross_sum) / 2.0 * cos(lat_avg) / map_projection.cos_avg_lat;
+        feature_metadata.draw_size[i] = std::abs(cross_sum) / 2.0;
+    }
+}
+
+void clear_projected_geometry() {
+    intersection_xy = ProjectedPoints();
+    poi_xy = ProjectedPoints();
+    segment_xy = ProjectedPolylines();
+    feature_xy = ProjectedPolylines();
+    way_xy = ProjectedPolylines();
+    feature_metadata = FeatureMetadataTable();
+}
+
+// the points of one row (segment, feature or way) as renderer points, reusing the vector
+void get_projected_row(const ProjectedPolylines& polylines, int row, std::vector<ezgl::point2d>& points) {
+    points.clear();
+    for (int k = polylines.offsets[row]; k < polylines.offsets[row + 1]; ++k) {
+        points.push_back({polylines.x[k], polylines.y[k]});
+    }
+}
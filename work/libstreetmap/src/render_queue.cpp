@@ -0,0 +1,130 @@
+//
+// Render queue between the map drawing and the renderer: lines and polygons are recorded with a
+// layer and a style, then drawn sorted by layer and style so each style is set and stroked once
+//
+
+#include "global.h"
+
+// Initialize value here
+thread_local RenderQueue render_queue;
+
+// start recording, drops anything not flushed
+void clear_render_queue() {
+    render_queue.commands.clear();
+    render_queue.points.clear();
+    render_queue.stats = RenderQueueStats();
+    render_queue.current_layer = 0;
+    render_queue.current_style = -1;
+}
+
+// the layer and style of the commands recorded next, layers are drawn in increasing order and
+// the commands of one layer in any order, so only things that may overlap in any order share a layer
+void queue_style(int layer, ezgl::color color, int line_width) {
+    // the state changes drawing in recording order would have made
+    if (render_queue.current_style == -1) {
+        render_queue.stats.style_changes += 2;
+    } else {
+        const RenderStyle& current = render_queue.styles[render_queue.current_style];
+        render_queue.stats.style_changes += !(current.color == color) + (current.line_width != line_width);
+    }
+
+    int style = 0;
+    while (style < render_queue.styles.size() && !(render_queue.styles[style].color == color &&
+                                                   render_queue.styles[style].line_width == line_width)) {
+        style++;
+    }
+    if (style == render_queue.styles.size()) {
+        render_queue.styles.push_back({color, line_width});
+    }
+    render_queue.current_layer = layer;
+    render_queue.current_style = style;
+}
+
+static void queue_command(RenderCommandKind kind, const ezgl::point2d* points, int count) {
+    if (count == 0) {
+        return;
+    }
+    RenderCommand command;
+    command.layer = render_queue.current_layer;
+    command.style = render_queue.current_style;
+    command.kind = kind;
+    command.first = render_queue.points.size();
+    command.count = count;
+    render_queue.commands.push_back(command);
+    render_queue.points.insert(render_queue.points.end(), points, points + count);
+}
+
+// separate lines, start and end point of each one after the other like renderer::draw_lines
+void queue_lines(const std::vector<ezgl::point2d>& lines) {
+    queue_command(LINES_COMMAND, lines.data(), lines.size());
+}
+
+void queue_polygon(const std::vector<ezgl::point2d>& polygon) {
+    queue_command(POLYGON_COMMAND, polygon.data(), polygon.size());
+}
+
+// a filled rectangle from its bottom left corner, like renderer::fill_rectangle
+void queue_rectangle(ezgl::point2d corner, double width, double height) {
+    ezgl::point2d rectangle[4] = {corner, {corner.x + width, corner.y}, {corner.x + width, corner.y + height},
+                                  {corner.x, corner.y + height}};
+    queue_command(POLYGON_COMMAND, rectangle, 4);
+}
+
+// draw the recorded commands sorted by layer, style and kind, one draw_lines or fill_polys per run of
+// equal keys, setting the colour and line width only when they change, then start recording again
+void flush_render_queue(ezgl::renderer* g) {
+    std::vector<RenderCommand>& commands = render_queue.commands;
+    std::stable_sort(commands.begin(), commands.end(), [](const RenderCommand& lhs, const RenderCommand& rhs) {
+        if (lhs.layer != rhs.layer) {
+            return lhs.layer < rhs.layer;
+        }
+        if (lhs.style != rhs.style) {
+            return lhs.style < rhs.style;
+        }
+        return lhs.kind < rhs.kind;
+    });
+
+    //reused between flushes so no batch is allocated while drawing
+    static thread_local std::vector<ezgl::point2d> batch;
+    static thread_local std::vector<int> offsets;
+    RenderQueueStats& stats = render_queue.stats;
+    stats.commands += commands.size();
+
+    const RenderStyle* drawn_style = nullptr;
+    for (int first = 0; first < commands.size();) {
+        int last = first;
+        while (last < commands.size() && commands[last].layer == commands[first].layer &&
+               commands[last].style == commands[first].style && commands[last].kind == commands[first].kind) {
+            last++;
+        }
+
+        const RenderStyle& style = render_queue.styles[commands[first].style];
+        if (drawn_style == nullptr || !(drawn_style->color == style.color)) {
+            g->set_color(style.color);
+            stats.state_changes++;
+        }
+        if (drawn_style == nullptr || drawn_style->line_width != style.line_width) {
+            g->set_line_width(style.line_width);
+            stats.state_changes++;
+        }
+        drawn_style = &style;
+
+        batch.clear();
+        offsets.assign(1, 0);
+        for (int k = first; k < last; ++k) {
+            auto points = render_queue.points.begin() + commands[k].first;
+            batch.insert(batch.end(), points, points + commands[k].count);
+            offsets.push_back(batch.size());
+        }
+        if (commands[first].kind == LINES_COMMAND) {
+            g->draw_lines(batch.data(), batch.size());
+        } else {
+            g->fill_polys(batch.data(), offsets.data(), offsets.size() - 1);
+        }
+        stats.batches++;
+        first = last;
+    }
+
+    add_render_queue_stats(stats);
+    clear_render_queue();
+}
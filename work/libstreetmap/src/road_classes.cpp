@@ -0,0 +1,115 @@
+//
+// Road classes: every street segment gets one class from the highway= tag of its OSM way, read once in
+// loadMap. The segment ids are grouped by class so a frame draws the classes its zoom needs straight
+// from the projected segment polylines, without a copy of the geometry per class
+//
+
+#include "global.h"
+
+// Initialize value here
+std::vector<RoadClass> segment_road_class;
+CompactAdjacency<StreetSegmentIdx> road_class_segments;
+thread_local CompactAdjacency<StreetSegmentIdx> visible_road_segments;
+
+// the rows drawn by this thread: visible_road_segments, or road_class_segments when the whole map is visible
+static thread_local const CompactAdjacency<StreetSegmentIdx>* drawn_road_segments = &road_class_segments;
+
+// highway= values of each class, the _link ramps are drawn with the road they join
+static const std::vector<std::pair<std::string, RoadClass>> highway_values = {
+    {"motorway", MOTORWAY_ROAD},
+    {"motorway_link", MOTORWAY_ROAD},
+    {"trunk", TRUNK_ROAD},
+    {"trunk_link", TRUNK_ROAD},
+    {"primary", PRIMARY_ROAD},
+    {"primary_link", PRIMARY_ROAD},
+    {"secondary", SECONDARY_ROAD},
+    {"secondary_link", SECONDARY_ROAD},
+    {"tertiary", TERTIARY_ROAD},
+    {"tertiary_link", TERTIARY_ROAD},
+    {"unclassified", UNCLASSIFIED_ROAD},
+    {"residential", RESIDENTIAL_ROAD},
+    {"living_street", RESIDENTIAL_ROAD},
+    {"service", SERVICE_ROAD}
+};
+
+// class of a segment whose way has no highway= value of the table, fast ones are drawn as motorways
+static RoadClass road_class_from_speed(StreetSegmentIdx i) {
+    float street_seg_speed = 3.6 * (getStreetSegmentInfo(i).speedLimit);
+    return street_seg_speed >= 90 ? MOTORWAY_ROAD : OTHER_ROAD;
+}
+
+// called from loadMap after load_osm_layers, one tag lookup per segment and a counting sort by class
+void load_road_classes() {
+    int numSegments = getNumStreetSegments();
+    int highway = find_osm_string("highway");
+
+    // the values are compared as string ids, values the map never uses are not in the pool
+    std::unordered_map<int, RoadClass> value_classes;
+    for (const auto& value : highway_values) {
+        int value_id = find_osm_string(value.first);
+        if (value_id != -1) {
+            value_classes[value_id] = value.second;
+        }
+    }
+
+    segment_road_class.resize(numSegments);
+    road_class_segments.offsets.assign(NUM_ROAD_CLASSES + 1, 0);
+    for (int i = 0; i < numSegments; ++i) {
+        segment_road_class[i] = road_class_from_speed(i);
+        int way = find_osmid_index(way_osmid_index, getStreetSegmentInfo(i).wayOSMID);
+        if (way != -1 && highway != -1) {
+            auto found = value_classes.find(find_osm_tag(way_tags, way, highway));
+            if (found != value_classes.end()) {
+                segment_road_class[i] = found->second;
+            }
+        }
+        road_class_segments.offsets[segment_road_class[i] + 1]++;
+    }
+    for (int c = 0; c < NUM_ROAD_CLASSES; ++c) {
+        road_class_segments.offsets[c + 1] += road_class_segments.offsets[c];
+    }
+
+    std::vector<int> next(road_class_segments.offsets.begin(), road_class_segments.offsets.end() - 1);
+    road_class_segments.values.resize(numSegments);
+    for (int i = 0; i < numSegments; ++i) {
+        road_class_segments.values[next[segment_road_class[i]]++] = i;
+    }
+}
+
+void clear_road_classes() {
+    std::vector<RoadClass>().swap(segment_road_class);
+    road_class_segments = CompactAdjacency<StreetSegmentIdx>();
+    visible_road_segments = CompactAdjacency<StreetSegmentIdx>();
+}
+
+// group visible_segments by class into visible_road_segments of the calling thread, ascending ids in each row,
+// a view of the whole map draws the classes straight from road_class_segments instead
+void load_visible_road_segments() {
+    if (visible_segments.size() == segment_road_class.size()) {
+        drawn_road_segments = &road_class_segments;
+        return;
+    }
+    drawn_road_segments = &visible_road_segments;
+
+    visible_road_segments.offsets.assign(NUM_ROAD_CLASSES + 1, 0);
+    for (StreetSegmentIdx i : visible_segments) {
+        visible_road_segments.offsets[segment_road_class[i] + 1]++;
+    }
+    for (int c = 0; c < NUM_ROAD_CLASSES; ++c) {
+        visible_road_segments.offsets[c + 1] += visible_road_segments.offsets[c];
+    }
+
+    static thread_local std::vector<int> next;
+    next.assign(visible_road_segments.offsets.begin(), visible_road_segments.offsets.end() - 1);
+    visible_road_segments.values.resize(visible_segments.size());
+    for (StreetSegmentIdx i : visible_segments) {
+        visible_road_segments.values[next[segment_road_class[i]]++] = i;
+    }
+}
+
+// the segments of one class on screen as lines, at the level of detail of this frame
+void add_road_class_lines(RoadClass road_class, std::vector<ezgl::point2d>& lines) {
+    for (StreetSegmentIdx i : (*drawn_road_segments)[road_class]) {
+        add_segment_lines(i, lines);
+    }
+}
@@ -0,0 +1,182 @@
+//
+// Route overlay: the found path, the segments explored by the search and the highlighted intersections,
+// drawn from their own lists on top of a cached image of the rest of the frame (the base layer),
+// so showing or clearing a route costs the length of the route and one blit.
+// The explored segments can also be played back in search order on the animation renderer
+//
+
+#include "global.h"
+
+// Initialize value here
+RouteOverlay route_overlay;
+
+// frame rate and length of the search playback, big searches play more segments per frame
+#define PLAYBACK_FPS 30
+#define PLAYBACK_SECONDS 4
+
+static const ezgl::color explored_color(120, 170, 255);
+static const ezgl::color frontier_color(220, 40, 40);
+
+// stop a playback, its explored segments are drawn by the next frame
+static void stop_search_playback() {
+    if (route_overlay.playback.timer != 0) {
+        g_source_remove(route_overlay.playback.timer);
+    }
+    route_overlay.playback = SearchPlayback();
+}
+
+// the segments of a path or of a search as lines, projected once when they are set
+static void add_overlay_lines(const std::vector<StreetSegmentIdx>& segments, std::vector<ezgl::point2d>& lines) {
+    lines.clear();
+    for (StreetSegmentIdx segment : segments) {
+        for (int k = segment_xy.offsets[segment] + 1; k < segment_xy.offsets[segment + 1]; ++k) {
+            lines.push_back({segment_xy.x[k - 1], segment_xy.y[k - 1]});
+            lines.push_back({segment_xy.x[k], segment_xy.y[k]});
+        }
+    }
+}
+
+// show a path and the segments the search explored to find it, in the order they were explored,
+// a segment explored again is kept at its first time
+void set_route_overlay(const std::vector<StreetSegmentIdx>& route, const std::vector<StreetSegmentIdx>& explored) {
+    stop_search_playback();
+    route_overlay.route = route;
+    route_overlay.explored.clear();
+    std::unordered_set<StreetSegmentIdx> seen;
+    for (StreetSegmentIdx segment : explored) {
+        if (seen.insert(segment).second) {
+            route_overlay.explored.push_back(segment);
+        }
+    }
+
+    add_overlay_lines(route_overlay.route, route_overlay.route_lines);
+    add_overlay_lines(route_overlay.explored, route_overlay.explored_lines);
+}
+
+void clear_route_overlay() {
+    stop_search_playback();
+    route_overlay.route.clear();
+    route_overlay.explored.clear();
+    route_overlay.route_lines.clear();
+    route_overlay.explored_lines.clear();
+}
+
+// the next frame draws the base layer again, for changes the view and style do not show (tiles coming in)
+void invalidate_base_layer() {
+    if (route_overlay.base.surface != nullptr) {
+        cairo_surface_destroy(route_overlay.base.surface);
+    }
+    route_overlay.base = BaseLayer();
+}
+
+// blit the base layer, drawing it first with draw_map_frame if the view or the style changed since it was drawn
+void draw_base_layer(ezgl::renderer* g) {
+    ezgl::rectangle world = g->get_visible_world();
+    ezgl::rectangle screen = g->get_visible_screen();
+    int width = std::lround(screen.width());
+    int height = std::lround(screen.height());
+    int style = map_style_key(current_map_style());
+    BaseLayer& base = route_overlay.base;
+
+    if (base.surface == nullptr || base.world != world || base.width != width || base.height != height ||
+        base.style != style) {
+        invalidate_base_layer();
+        ezgl::renderer::draw_call_counts counts;
+        if (main_canvas != nullptr) {
+            base.surface = main_canvas->render_to_image(world, width, height, draw_map_frame, &counts);
+        }
+        if (base.surface == nullptr) {
+            // no canvas to render it with, or no memory for the image
+            draw_map_frame(g);
+            return;
+        }
+        base.world = world;
+        base.width = width;
+        base.height = height;
+        base.style = style;
+        g->add_draw_call_counts(counts);
+    }
+
+    begin_render_pass(BASE_LAYER_PASS);
+    g->set_horiz_justification(ezgl::justification::left);
+    g->set_vert_justification(ezgl::justification::top);
+    g->draw_surface(base.surface, world.top_left());
+    g->set_horiz_justification(ezgl::justification::center);
+    g->set_vert_justification(ezgl::justification::center);
+    end_render_pass(BASE_LAYER_PASS);
+}
+
+// the explored segments under the path, then the highlighted intersections
+void draw_route_overlay(ezgl::renderer* g) {
+    begin_render_pass(ROUTE_PASS);
+    // while playing back, only what was played so far
+    int explored_points = route_overlay.explored_lines.size();
+    if (route_overlay.playback.active) {
+        explored_points = route_overlay.playback.played;
+    }
+    if (explored_points > 0) {
+        g->set_line_width(2);
+        g->set_color(explored_color);
+        g->draw_lines(route_overlay.explored_lines.data(), explored_points);
+    }
+    if (!route_overlay.route_lines.empty()) {
+        g->set_line_width(4);
+        g->set_color(ezgl::YELLOW);
+        g->draw_lines(route_overlay.route_lines.data(), route_overlay.route_lines.size());
+    }
+    end_render_pass(ROUTE_PASS);
+
+    begin_render_pass(INTERSECTIONS_PASS);
+    draw_intersections(g);
+    end_render_pass(INTERSECTIONS_PASS);
+}
+
+// one frame of the playback on the animation renderer, on top of the last full frame:
+// the previous batch back in the explored colour, then the next batch as the frontier
+static gboolean search_playback_tick(gpointer /*data*/) {
+    SearchPlayback& playback = route_overlay.playback;
+    const std::vector<ezgl::point2d>& lines = route_overlay.explored_lines;
+    ezgl::renderer* g = playback.application->get_renderer();
+    int next = std::min<int>(lines.size(), playback.played + playback.points_per_frame);
+
+    g->set_line_width(2);
+    g->set_color(explored_color);
+    g->draw_lines(lines.data() + playback.frontier, playback.played - playback.frontier);
+    g->set_color(frontier_color);
+    g->draw_lines(lines.data() + playback.played, next - playback.played);
+    playback.frontier = playback.played;
+    playback.played = next;
+
+    if (playback.played == lines.size()) {
+        // a last full frame puts the path back on top
+        ezgl::application* application = playback.application;
+        route_overlay.playback = SearchPlayback();
+        application->refresh_drawing();
+        return G_SOURCE_REMOVE;
+    }
+    // the playback may be stopped while the drawing is flushed
+    playback.application->flush_drawing();
+    return G_SOURCE_CONTINUE;
+}
+
+// "Replay Search" button: play the segments explored by the last path search in the order the search
+// expanded them, at most PLAYBACK_FPS frames a second, without drawing the map again
+void play_search_exploration(GtkWidget* /*widget*/, ezgl::application* application) {
+    stop_search_playback();
+    if (route_overlay.explored_lines.empty()) {
+        application->update_message("No search to replay, find a path by clicking two intersections");
+        return;
+    }
+
+    SearchPlayback& playback = route_overlay.playback;
+    int frames = PLAYBACK_FPS * PLAYBACK_SECONDS;
+    int num_lines = route_overlay.explored_lines.size() / 2;
+    playback.active = true;
+    playback.application = application;
+    playback.points_per_frame = 2 * std::max(1, (num_lines + frames - 1) / frames);
+    application->update_message("Replaying " + std::to_string(route_overlay.explored.size()) + " explored segments");
+
+    // the base layer and the path, without the explored segments
+    application->refresh_drawing();
+    playback.timer = g_timeout_add(1000 / PLAYBACK_FPS, search_playback_tick, nullptr);
+}
@@ -0,0 +1,179 @@
+//
+// Uniform grids over the world bounding boxes of street segments, features and subway rails,
+// so each redraw only visits what intersects the visible world
+//
+
+#include "global.h"
+
+// Initialize value here
+SpatialGrid segment_grid;
+SpatialGrid feature_grid;
+SpatialGrid subway_grid;
+std::vector<int> subway_ways;
+// per thread, so the tile workers can each draw their own part of the map
+thread_local std::vector<StreetSegmentIdx> visible_segments;
+thread_local CompactAdjacency<FeatureIdx> visible_features;
+std::vector<int> feature_draw_rank;
+
+// average number of items per cell the grids are sized for
+#define ITEMS_PER_CELL 4
+// cap on the cells per side, so a few huge boxes can not blow up the grid
+#define MAX_GRID_SIDE 2048
+
+static int grid_col(const SpatialGrid& grid, double x) {
+    int col = (x - grid.min_x) / grid.cell_size;
+    return std::max(0, std::min(grid.num_cols - 1, col));
+}
+
+static int grid_row(const SpatialGrid& grid, double y) {
+    int row = (y - grid.min_y) / grid.cell_size;
+    return std::max(0, std::min(grid.num_rows - 1, row));
+}
+
+// build a grid from one bounding box per item, an item is listed in every cell its box touches
+void build_spatial_grid(SpatialGrid& grid, const std::vector<double>& min_x, const std::vector<double>& max_x,
+                        const std::vector<double>& min_y, const std::vector<double>& max_y) {
+    int num_items = min_x.size();
+    grid = SpatialGrid();
+    if (num_items == 0) {
+        grid.cells.offsets.assign(1, 0);
+        return;
+    }
+
+    grid.min_x = *std::min_element(min_x.begin(), min_x.end());
+    grid.min_y = *std::min_element(min_y.begin(), min_y.end());
+    double width = *std::max_element(max_x.begin(), max_x.end()) - grid.min_x;
+    double height = *std::max_element(max_y.begin(), max_y.end()) - grid.min_y;
+
+    // square cells, about ITEMS_PER_CELL items each if they were spread evenly
+    double num_cells = std::max(1, num_items / ITEMS_PER_CELL);
+    grid.cell_size = std::sqrt(std::max(width * height, 1.0) / num_cells);
+    grid.cell_size = std::max({grid.cell_size, width / MAX_GRID_SIDE, height / MAX_GRID_SIDE, 1.0});
+    grid.num_cols = std::min<int>(MAX_GRID_SIDE, width / grid.cell_size + 1);
+    grid.num_rows = std::min<int>(MAX_GRID_SIDE, height / grid.cell_size + 1);
+
+    // counting pass then filling pass, like the other CSR tables
+    int total_cells = grid.num_cols * grid.num_rows;
+    grid.cells.offsets.assign(total_cells + 1, 0);
+    for (int i = 0; i < num_items; ++i) {
+        for (int row = grid_row(grid, min_y[i]); row <= grid_row(grid, max_y[i]); ++row) {
+            for (int col = grid_col(grid, min_x[i]); col <= grid_col(grid, max_x[i]); ++col) {
+                grid.cells.offsets[row * grid.num_cols + col + 1]++;
+            }
+        }
+    }
+    for (int c = 0; c < total_cells; ++c) {
+        grid.cells.offsets[c + 1] += grid.cells.offsets[c];
+    }
+
+    std::vector<int> next(grid.cells.offsets.begin(), grid.cells.offsets.end() - 1);
+    grid.cells.values.resize(grid.cells.offsets[total_cells]);
+    for (int i = 0; i < num_items; ++i) {
+        for (int row = grid_row(grid, min_y[i]); row <= grid_row(grid, max_y[i]); ++row) {
+            for (int col = grid_col(grid, min_x[i]); col <= grid_col(grid, max_x[i]); ++col) {
+                grid.cells.values[next[row * grid.num_cols + col]++] = i;
+            }
+        }
+    }
+}
+
+// ids of the items whose cells intersect the area, each id once, in ascending order
+void query_spatial_grid(const SpatialGrid& grid, const ezgl::rectangle& area, std::vector<int>& result) {
+    result.clear();
+    if (grid.num_cols == 0 || area.right() < grid.min_x || area.top() < grid.min_y ||
+        area.left() > grid.min_x + grid.cell_size * grid.num_cols ||
+        area.bottom() > grid.min_y + grid.cell_size * grid.num_rows) {
+        return;
+    }
+
+    for (int row = grid_row(grid, area.bottom()); row <= grid_row(grid, area.top()); ++row) {
+        for (int col = grid_col(grid, area.left()); col <= grid_col(grid, area.right()); ++col) {
+            IndexSpan<int> cell = grid.cells[row * grid.num_cols + col];
+            result.insert(result.end(), cell.begin(), cell.end());
+        }
+    }
+
+    // an item in several cells is listed once, the grid is only read so threads can query at the same time
+    std::sort(result.begin(), result.end());
+    result.erase(std::unique(result.begin(), result.end()), result.end());
+}
+
+// called from loadMap after load_feature_buckets
+void load_spatial_index() {
+    int numSegments = getNumStreetSegments();
+    std::vector<double> min_x(numSegments), max_x(numSegments), min_y(numSegments), max_y(numSegments);
+    for (int i = 0; i < numSegments; ++i) {
+        auto first = segment_xy.x.begin() + segment_xy.offsets[i];
+        auto last = segment_xy.x.begin() + segment_xy.offsets[i + 1];
+        min_x[i] = *std::min_element(first, last);
+        max_x[i] = *std::max_element(first, last);
+        first = segment_xy.y.begin() + segment_xy.offsets[i];
+        last = segment_xy.y.begin() + segment_xy.offsets[i + 1];
+        min_y[i] = *std::min_element(first, last);
+        max_y[i] = *std::max_element(first, last);
+    }
+    build_spatial_grid(segment_grid, min_x, max_x, min_y, max_y);
+
+    build_spatial_grid(feature_grid, feature_metadata.min_x, feature_metadata.max_x,
+                       feature_metadata.min_y, feature_metadata.max_y);
+
+    // the subway rail ways with at least one piece, item k of subway_grid is way subway_ways[k] of way_xy
+    min_x.clear();
+    max_x.clear();
+    min_y.clear();
+    max_y.clear();
+    for (int way : osm_layer_matches(SUBWAY_RAIL_LAYER)) {
+        if (way_xy.offsets[way + 1] - way_xy.offsets[way] < 2) {
+            continue;
+        }
+        subway_ways.push_back(way);
+        auto first = way_xy.x.begin() + way_xy.offsets[way];
+        auto last = way_xy.x.begin() + way_xy.offsets[way + 1];
+        min_x.push_back(*std::min_element(first, last));
+        max_x.push_back(*std::max_element(first, last));
+        first = way_xy.y.begin() + way_xy.offsets[way];
+        last = way_xy.y.begin() + way_xy.offsets[way + 1];
+        min_y.push_back(*std::min_element(first, last));
+        max_y.push_back(*std::max_element(first, last));
+    }
+    build_spatial_grid(subway_grid, min_x, max_x, min_y, max_y);
+
+    // position of every feature in feature_buckets, so the visible ones can be put back in draw order
+    feature_draw_rank.resize(feature_buckets.values.size());
+    for (int k = 0; k < feature_buckets.values.size(); ++k) {
+        feature_draw_rank[feature_buckets.values[k]] = k;
+    }
+}
+
+void clear_spatial_index() {
+    segment_grid = SpatialGrid();
+    feature_grid = SpatialGrid();
+    subway_grid = SpatialGrid();
+    std::vector<int>().swap(subway_ways);
+    std::vector<StreetSegmentIdx>().swap(visible_segments);
+    visible_features = CompactAdjacency<FeatureIdx>();
+    std::vector<int>().swap(feature_draw_rank);
+}
+
+// fill visible_segments (ascending ids), visible_road_segments and visible_features (same rows and order as feature_buckets)
+// of the calling thread with what intersects the visible world, called once per frame and per tile
+void load_visible_items(const ezgl::rectangle& visible_world) {
+    query_spatial_grid(segment_grid, visible_world, visible_segments);
+
+    std::vector<FeatureIdx>& features = visible_features.values;
+    query_spatial_grid(feature_grid, visible_world, features);
+    std::sort(features.begin(), features.end(), [](FeatureIdx lhs, FeatureIdx rhs) {
+        return feature_draw_rank[lhs] < feature_draw_rank[rhs];
+    });
+
+    // sorted by rank the features are grouped by type, find where each row starts
+    int numTypes = feature_buckets.size();
+    visible_features.offsets.assign(numTypes + 1, 0);
+    for (int k = 0; k < features.size(); ++k) {
+        visible_features.offsets[getFeatureType(features[k]) + 1]++;
+    }
+    for (int t = 0; t < numTypes; ++t) {
+        visible_features.offsets[t + 1] += visible_features.offsets[t];
+    }
+    load_visible_road_segments();
+}
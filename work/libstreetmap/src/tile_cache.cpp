@@ -0,0 +1,347 @@
+//
+// Raster tile cache: the map base (features, streets, subway routes) rendered into fixed world-space
+// tiles at discrete zoom levels by background workers, so panning and zooming blit images
+//
+
+#include "global.h"
+
+// Initialize value here
+TileCache tile_cache;
+
+// the least recently drawn tiles are dropped past this many bytes of images
+#define MAX_TILE_CACHE_BYTES (256 * 1024 * 1024)
+#define MAX_TILE_WORKERS 4
+// coarser levels looked at for a stand-in while a tile is being rendered
+#define MAX_FALLBACK_LEVELS 4
+
+static size_t tile_bytes() {
+    return size_t(4) * TILE_PIXELS * TILE_PIXELS;
+}
+
+// world size of a tile, caller holds the lock
+static double tile_size(int zoom) {
+    return tile_cache.map_width / (1 << zoom);
+}
+
+// world rectangle of a tile, caller holds the lock
+static ezgl::rectangle tile_world(const TileKey& key) {
+    double size = tile_size(key.zoom);
+    ezgl::point2d bottom_left(tile_cache.origin_x + key.x * size, tile_cache.origin_y + key.y * size);
+    return ezgl::rectangle(bottom_left, size, size);
+}
+
+// free every tile, caller holds the lock
+static void drop_tiles() {
+    for (auto& tile : tile_cache.tiles) {
+        cairo_surface_destroy(tile.second.surface);
+    }
+    tile_cache.tiles.clear();
+    tile_cache.lru.clear();
+    tile_cache.bytes = 0;
+}
+
+// a rendered tile is only kept if nothing was invalidated while it was drawn, caller holds the lock
+static void insert_tile(const TileKey& key, cairo_surface_t* surface) {
+    if (tile_cache.tiles.count(key)) {
+        cairo_surface_destroy(surface);
+        return;
+    }
+    tile_cache.lru.push_front(key);
+    tile_cache.tiles[key] = {surface, tile_cache.lru.begin()};
+    tile_cache.bytes += tile_bytes();
+
+    while (tile_cache.bytes > MAX_TILE_CACHE_BYTES && !tile_cache.lru.empty()) {
+        auto oldest = tile_cache.tiles.find(tile_cache.lru.back());
+        cairo_surface_destroy(oldest->second.surface);
+        tile_cache.tiles.erase(oldest);
+        tile_cache.lru.pop_back();
+        tile_cache.bytes -= tile_bytes();
+    }
+}
+
+// runs on the GTK main loop once tiles came in, several finished tiles share one redraw
+static gboolean refresh_after_tiles(gpointer /*data*/) {
+    {
+        std::lock_guard<std::mutex> lock(tile_cache.mutex);
+        tile_cache.refresh_queued = false;
+    }
+    if (tile_cache.application != nullptr) {
+        invalidate_base_layer();
+        tile_cache.application->refresh_drawing();
+    }
+    return G_SOURCE_REMOVE;
+}
+
+// true if a strip of a parallel redraw is waiting for a thread, caller holds the lock
+static bool strip_waiting() {
+    return tile_cache.strip_jobs != nullptr && tile_cache.next_strip < tile_cache.strip_jobs->size();
+}
+
+// render the strips of parallel redraws and the queued tiles until stop_tile_cache,
+// the GTK thread waits for the strips so they go first
+static void tile_worker() {
+    std::unique_lock<std::mutex> lock(tile_cache.mutex);
+    while (true) {
+        tile_cache.work_ready.wait(lock, [] {
+            return tile_cache.stopping || strip_waiting() || !tile_cache.requests.empty();
+        });
+        if (tile_cache.stopping) {
+            return;
+        }
+
+        if (strip_waiting()) {
+            const std::function<void()>& strip = (*tile_cache.strip_jobs)[tile_cache.next_strip++];
+            map_style = tile_cache.strip_style;
+            tile_cache.strips_running++;
+            lock.unlock();
+
+            strip();
+
+            lock.lock();
+            tile_cache.strips_running--;
+            tile_cache.work_done.notify_all();
+            continue;
+        }
+
+        TileKey key = tile_cache.requests.front();
+        tile_cache.requests.pop_front();
+        // the style is captured with the generation, the tile is drawn with it even if the toggles change
+        int generation = tile_cache.generation;
+        map_style = map_style_from_key(tile_cache.style);
+        ezgl::rectangle world = tile_world(key);
+        tile_cache.active_renders++;
+        lock.unlock();
+
+        cairo_surface_t* surface = tile_cache.canvas->render_to_image(world, TILE_PIXELS, TILE_PIXELS, draw_map_tile);
+
+        lock.lock();
+        tile_cache.active_renders--;
+        if (generation == tile_cache.generation) {
+            tile_cache.pending.erase(key);
+            if (surface != nullptr) {
+                insert_tile(key, surface);
+                surface = nullptr;
+            }
+            if (!tile_cache.refresh_queued) {
+                tile_cache.refresh_queued = true;
+                g_idle_add(refresh_after_tiles, nullptr);
+            }
+        }
+        if (surface != nullptr) {
+            cairo_surface_destroy(surface);
+        }
+        tile_cache.work_done.notify_all();
+    }
+}
+
+// called from initial_setup_pinkify_switch_with_text once the main canvas exists
+void start_tile_cache(ezgl::application* application) {
+    if (!tile_cache.workers.empty()) {
+        return;
+    }
+    tile_cache.application = application;
+    tile_cache.canvas = application->get_canvas(application->get_main_canvas_id());
+    tile_cache.stopping = false;
+
+    // leave a core to the GTK main loop
+    int num_workers = std::max(1, std::min<int>(MAX_TILE_WORKERS, std::thread::hardware_concurrency() - 1));
+    for (int i = 0; i < num_workers; ++i) {
+        tile_cache.workers.emplace_back(tile_worker);
+    }
+}
+
+// threads a parallel redraw can use: the tile workers and the GTK thread
+int num_render_threads() {
+    return tile_cache.workers.size() + 1;
+}
+
+// run the strips of a parallel redraw on the tile workers and on the GTK thread, which takes strips
+// too until none is left, so a redraw adds no threads to the ones already rendering tiles
+void run_on_tile_workers(const std::vector<std::function<void()>>& jobs) {
+    std::unique_lock<std::mutex> lock(tile_cache.mutex);
+    tile_cache.strip_jobs = &jobs;
+    tile_cache.next_strip = 0;
+    tile_cache.strip_style = map_style;
+    tile_cache.work_ready.notify_all();
+
+    while (strip_waiting()) {
+        int strip = tile_cache.next_strip++;
+        lock.unlock();
+        jobs[strip]();
+        lock.lock();
+    }
+    tile_cache.work_done.wait(lock, [] { return tile_cache.strips_running == 0; });
+    tile_cache.strip_jobs = nullptr;
+}
+
+// called once the application stopped running, before the canvas is destroyed
+void stop_tile_cache() {
+    {
+        std::lock_guard<std::mutex> lock(tile_cache.mutex);
+        tile_cache.stopping = true;
+        tile_cache.requests.clear();
+        tile_cache.pending.clear();
+    }
+    tile_cache.work_ready.notify_all();
+    for (std::thread& worker : tile_cache.workers) {
+        worker.join();
+    }
+    tile_cache.workers.clear();
+
+    std::lock_guard<std::mutex> lock(tile_cache.mutex);
+    drop_tiles();
+    tile_cache.application = nullptr;
+    tile_cache.canvas = nullptr;
+}
+
+// forget every tile, the ones being rendered are thrown away when they finish
+void invalidate_tile_cache() {
+    std::lock_guard<std::mutex> lock(tile_cache.mutex);
+    tile_cache.generation++;
+    tile_cache.requests.clear();
+    tile_cache.pending.clear();
+    drop_tiles();
+}
+
+// called first thing in closeMap, no worker may still be reading the map when it is freed
+void clear_tile_cache() {
+    invalidate_tile_cache();
+    std::unique_lock<std::mutex> lock(tile_cache.mutex);
+    tile_cache.work_done.wait(lock, [] { return tile_cache.active_renders == 0; });
+    tile_cache.style = -1;
+}
+
+// blit the tiles of the zoom level nearest to the current scale, standing in coarser tiles for the
+// ones still missing and queueing those for the workers. Returns false without drawing anything
+// if some visible tile has no stand-in either, the caller then draws the map base itself
+bool draw_cached_tiles(ezgl::renderer* g) {
+    ezgl::rectangle visible_world = g->get_visible_world();
+    double world_per_pixel = 1.0 / distance_scaling_fct(g);
+    double origin_x = x_from_lon(min_lon);
+    double origin_y = y_from_lat(min_lat);
+    double map_width = x_from_lon(max_lon) - origin_x;
+    double map_height = y_from_lat(max_lat) - origin_y;
+    int style = map_style_key(current_map_style());
+
+    if (map_width <= 0.0 || map_height <= 0.0) {
+        return false;
+    }
+    if (style != tile_cache.style || origin_x != tile_cache.origin_x || origin_y != tile_cache.origin_y ||
+        map_width != tile_cache.map_width) {
+        invalidate_tile_cache();
+        std::lock_guard<std::mutex> lock(tile_cache.mutex);
+        tile_cache.style = style;
+        tile_cache.origin_x = origin_x;
+        tile_cache.origin_y = origin_y;
+        tile_cache.map_width = map_width;
+    }
+
+    // zoom 0 fits the map width in one tile
+    double zoom_scale = map_width / TILE_PIXELS / world_per_pixel;
+    int zoom = std::max(0, std::min(MAX_TILE_ZOOM, int(std::lround(std::log2(zoom_scale)))));
+    double size = map_width / (1 << zoom);
+    int max_x = (1 << zoom) - 1;
+    int max_y = int(std::ceil(map_height / size)) - 1;
+    int first_x = std::max(0, int(std::floor((visible_world.left() - origin_x) / size)));
+    int last_x = std::min(max_x, int(std::floor((visible_world.right() - origin_x) / size)));
+    int first_y = std::max(0, int(std::floor((visible_world.bottom() - origin_y) / size)));
+    int last_y = std::min(max_y, int(std::floor((visible_world.top() - origin_y) / size)));
+
+    // missing tiles nearest to the center of the view are rendered first
+    std::vector<TileKey> visible;
+    for (int y = first_y; y <= last_y; ++y) {
+        for (int x = first_x; x <= last_x; ++x) {
+            visible.push_back({zoom, x, y});
+        }
+    }
+    double center_x = (visible_world.left() + visible_world.right()) / 2.0;
+    double center_y = (visible_world.bottom() + visible_world.top()) / 2.0;
+    std::sort(visible.begin(), visible.end(), [&](const TileKey& lhs, const TileKey& rhs) {
+        double lx = origin_x + (lhs.x + 0.5) * size - center_x, ly = origin_y + (lhs.y + 0.5) * size - center_y;
+        double rx = origin_x + (rhs.x + 0.5) * size - center_x, ry = origin_y + (rhs.y + 0.5) * size - center_y;
+        return lx * lx + ly * ly < rx * rx + ry * ry;
+    });
+
+    // tiles to draw with a reference each, coarse stand-ins first so the exact tiles go on top
+    std::vector<std::pair<TileKey, cairo_surface_t*>> fallbacks;
+    std::vector<std::pair<TileKey, cairo_surface_t*>> exact;
+    bool covered = true;
+    {
+        std::lock_guard<std::mutex> lock(tile_cache.mutex);
+        for (const TileKey& key : tile_cache.requests) {
+            tile_cache.pending.erase(key);
+        }
+        tile_cache.requests.clear();
+
+        for (const TileKey& key : visible) {
+            auto tile = tile_cache.tiles.find(key);
+            if (tile != tile_cache.tiles.end()) {
+                tile_cache.lru.splice(tile_cache.lru.begin(), tile_cache.lru, tile->second.lru_position);
+                exact.push_back({key, cairo_surface_reference(tile->second.surface)});
+                continue;
+            }
+
+            if (!tile_cache.pending.count(key)) {
+                tile_cache.pending.insert(key);
+                tile_cache.requests.push_back(key);
+            }
+
+            bool found = false;
+            for (int level = 1; level <= MAX_FALLBACK_LEVELS && level <= zoom && !found; ++level) {
+                TileKey parent = {zoom - level, key.x >> level, key.y >> level};
+                auto parent_tile = tile_cache.tiles.find(parent);
+                if (parent_tile == tile_cache.tiles.end()) {
+                    continue;
+                }
+                found = true;
+                bool listed = false;
+                for (const auto& fallback : fallbacks) {
+                    listed = listed || fallback.first == parent;
+                }
+                if (!listed) {
+                    tile_cache.lru.splice(tile_cache.lru.begin(), tile_cache.lru, parent_tile->second.lru_position);
+                    fallbacks.push_back({parent, cairo_surface_reference(parent_tile->second.surface)});
+                }
+            }
+            covered = covered && found;
+        }
+    }
+    tile_cache.work_ready.notify_all();
+
+    if (covered) {
+        std::sort(fallbacks.begin(), fallbacks.end(), [](const auto& lhs, const auto& rhs) {
+            return lhs.first.zoom < rhs.first.zoom;
+        });
+        fallbacks.insert(fallbacks.end(), exact.begin(), exact.end());
+
+        draw_map_background(g);
+        g->set_horiz_justification(ezgl::justification::left);
+        g->set_vert_justification(ezgl::justification::top);
+        for (const auto& tile : fallbacks) {
+            double tile_world_size = map_width / (1 << tile.first.zoom);
+            ezgl::point2d top_left(origin_x + tile.first.x * tile_world_size,
+                                   origin_y + (tile.first.y + 1) * tile_world_size);
+            g->draw_surface(tile.second, top_left, tile_world_size / TILE_PIXELS / world_per_pixel);
+        }
+        g->set_horiz_justification(ezgl::justification::center);
+        g->set_vert_justification(ezgl::justification::center);
+    }
+
+    for (const auto& tile : fallbacks) {
+        cairo_surface_destroy(tile.second);
+    }
+    if (!covered) {
+        for (const auto& tile : exact) {
+            cairo_surface_destroy(tile.second);
+        }
+    }
+    return covered;
+}
+
+// "Tiles" button: switch between the tile cache and drawing the whole map every frame
+void toggle_tile_cache(GtkWidget* /*widget*/, ezgl::application* application) {
+    tile_cache.enabled = !tile_cache.enabled;
+    application->update_message(tile_cache.enabled ? "Tile cache on" : "Tile cache off");
+    invalidate_base_layer();
+    application->refresh_drawing();
+}
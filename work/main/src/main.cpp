@@ -29,6 +29,16 @@ constexpr int BAD_ARGUMENTS_EXIT_CODE = 2;  //Invalid command-line usage
 std::string default_map_path = "/cad2/ece297s/public/maps/toronto_canada.streets.bin";
 std::string map_OSM_database_filename;
 
+//libstreetmap/src/fuzzy_search.cpp
+void benchmark_fuzzy_search(int num_queries);
+
+//libstreetmap/src/distance_kernels.cpp
+void benchmark_distance_kernels(int repeats);
+
+//libstreetmap/src/headless_render.cpp
+bool render_box_file(const std::string& path, int num_threads);
+bool render_tile_pyramid(int max_zoom, const std::string& out_dir, const std::string& extension, int num_threads);
+
 
 // The start routine of your program (main) when you are running your standalone
 // mapper program. This main routine is *never called* when you are running 
@@ -39,6 +49,12 @@ std::string map_OSM_database_filename;
 int main(int argc, char** argv) {
 
     std::string map_path;
+    bool benchmark_distance = false;
+    bool benchmark_search = false;
+    std::string render_boxes_path;
+    std::string render_tiles_dir;
+    int render_max_zoom = 0;
+    std::string render_extension = "png";
 
     if(argc == 1) {
         //Use a default map
@@ -46,10 +62,33 @@ int main(int argc, char** argv) {
     } else if (argc == 2) {
         //Get the map from the command line
         map_path = argv[1];
+    } else if (argc == 3 && std::string(argv[2]) == "--benchmark-distance") {
+        //Time the distance kernels on this map instead of opening the window
+        map_path = argv[1];
+        benchmark_distance = true;
+    } else if (argc == 3 && std::string(argv[2]) == "--benchmark-search") {
+        //Time the fuzzy name search on this map instead of opening the window
+        map_path = argv[1];
+        benchmark_search = true;
+    } else if (argc == 4 && std::string(argv[2]) == "--render-boxes") {
+        //Write an image per bounding box of the file instead of opening the window
+        map_path = argv[1];
+        render_boxes_path = argv[3];
+    } else if ((argc == 5 || argc == 6) && std::string(argv[2]) == "--render-tiles") {
+        //Write the tile pyramid up to a zoom level instead of opening the window
+        map_path = argv[1];
+        render_max_zoom = std::atoi(argv[3]);
+        render_tiles_dir = argv[4];
+        if (argc == 6) {
+            render_extension = argv[5];
+        }
     } else {
         //Invalid arguments
-        std::cerr << "Usage: " << argv[0] << " [map_file_path]\n";
+        std::cerr << "Usage: " << argv[0] << " [map_file_path] [--benchmark-distance | --benchmark-search]\n";
+        std::cerr << "       " << argv[0] << " map_file_path --render-boxes boxes_file\n";
+        std::cerr << "       " << argv[0] << " map_file_path --render-tiles max_zoom out_dir [png|svg]\n";
         std::cerr << "  If no map_file_path is provided a default map is loaded.\n";
+        std::cerr << "  A boxes_file line is: file_name min_lon min_lat max_lon max_lat width height\n";
         return BAD_ARGUMENTS_EXIT_CODE;
     }
 
@@ -67,7 +106,24 @@ int main(int argc, char** argv) {
 
     //You can now do something with the map data
 
-    drawMap();
+    //Images are rendered on every core, no display is needed
+    int num_threads = std::max(1u, std::thread::hardware_concurrency());
+    int exit_code = SUCCESS_EXIT_CODE;
+    if (benchmark_distance) {
+        benchmark_distance_kernels(100);
+    } else if (benchmark_search) {
+        benchmark_fuzzy_search(10000);
+    } else if (!render_boxes_path.empty()) {
+        if (!render_box_file(render_boxes_path, num_threads)) {
+            exit_code = ERROR_EXIT_CODE;
+        }
+    } else if (!render_tiles_dir.empty()) {
+        if (!render_tile_pyramid(render_max_zoom, render_tiles_dir, render_extension, num_threads)) {
+            exit_code = ERROR_EXIT_CODE;
+        }
+    } else {
+        drawMap();
+    }
 
     //Clean-up the map data and related data structures
     std::cout << "Closing map\n";
@@ -82,5 +138,5 @@ int main(int argc, char** argv) {
 //    depots = {50, 200};
 //    turn_penalty = 30.000000000;
 //    result_path = travelingCourier(turn_penalty, deliveries, depots);
-    return SUCCESS_EXIT_CODE;
+    return exit_code;
 }